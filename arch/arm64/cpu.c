@@ -65,8 +65,8 @@ int hypercall(unsigned long no, unsigned long arg1)
 	BUG();
 }
 
-/* Flush an entire address space on every CPU, including this one. */
-void flush_tlb_asid(unsigned long asid)
+/* Flush an entire address space on this CPU and on the CPUs in cpus. */
+void flush_tlb_asid(unsigned long *cpus, unsigned long asid)
 {
 	/* aside1is broadcasts across the inner-shareable domain. */
 	asm volatile(
@@ -82,6 +82,7 @@ void flush_tlb_asid(unsigned long asid)
  * (tlbi ...is), so translations on other CPUs are already invalidated by
  * the local unmap. Nothing to shoot down separately.
  */
-void flush_tlb_others_asid(unsigned long asid, const void *addr, size_t size)
+void flush_tlb_others_asid(unsigned long *cpus, unsigned long asid,
+			   const void *addr, size_t size)
 {
 }
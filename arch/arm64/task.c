@@ -25,7 +25,7 @@ void task_set_context(struct task *task, unsigned long pc, unsigned long sp)
 	task->regs.sp = sp;
 }
 
-void arch_process_activate(struct process *p)
+void arch_process_activate(struct process *p, bool flush_tlb)
 {
 	unsigned long tmp;
 
@@ -34,12 +34,11 @@ void arch_process_activate(struct process *p)
 	instruction_barrier();
 
 	/*
-	 * A process without its own ASID shares ASID 0 with every other
-	 * untagged process, so its predecessor's user translations must be
-	 * flushed here - there is no tag to keep them apart.
+	 * Flush after the switch, so that nothing of the previous address
+	 * space can be walked in afterwards under a recycled or shared ASID.
 	 */
-	if (!p->mm.asid)
-		local_flush_tlb_asid(0);
+	if (flush_tlb)
+		local_flush_tlb_all();
 
 	/* The kernel runs with TTBR0 walks off; enable them for EL0 */
 	arm_read_sysreg(TCR, tmp);
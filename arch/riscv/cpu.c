@@ -21,6 +21,7 @@
 #include <grinch/panic.h>
 #include <grinch/printk.h>
 #include <grinch/smp.h>
+#include <grinch/task.h>
 #include <grinch/timer.h>
 
 #include <grinch/arch/sbi.h>
@@ -142,26 +143,30 @@ void flush_tlb_all(void)
 	}
 }
 
-/* Flush an entire address space on every CPU, including this one. */
-void flush_tlb_asid(unsigned long asid)
+/* Flush an entire address space on this CPU and on the CPUs in cpus. */
+void flush_tlb_asid(unsigned long *cpus, unsigned long asid)
 {
 	local_flush_tlb_asid(asid);
-	flush_tlb_others_asid(asid, 0, 0);
+	flush_tlb_others_asid(cpus, asid, 0, 0);
 }
 
 /*
- * Shoot down a range of an address space on every other CPU. The local
- * CPU is left untouched; the caller has already flushed it. Only remote
- * CPUs need an explicit fence, as they cannot see our local sfence.vma.
+ * Shoot down a range of an address space on the other CPUs in cpus. The
+ * local CPU is left untouched; the caller has already flushed it. Only
+ * remote CPUs need an explicit fence, as they cannot see our local
+ * sfence.vma. Offline CPUs hold no translations and are skipped.
  */
-void flush_tlb_others_asid(unsigned long asid, const void *addr, size_t size)
+void flush_tlb_others_asid(unsigned long *cpus, unsigned long asid,
+			   const void *addr, size_t size)
 {
 	unsigned long hmask;
 	struct sbiret ret;
 	unsigned int cpu;
 
 	hmask = 0;
-	for_each_online_cpu_except_this(cpu) {
+	for_each_cpu_except(cpu, cpus, this_cpu_id()) {
+		if (!cpu_is_online(cpu))
+			continue;
 		if (cpu > 63)
 			BUG();
 		hmask |= (1UL << cpu);
@@ -80,6 +80,12 @@ static inline void regs_set_retval(struct registers *r, unsigned long val)
 	r->a0 = val;
 }
 
+/* Rewind to the syscall instruction. Its arguments are still in place. */
+static inline void regs_restart_syscall(struct registers *r)
+{
+	r->pc -= 4;
+}
+
 static __always_inline void cpu_relax(void)
 {
 	asm volatile ("" : : : "memory");
@@ -53,7 +53,7 @@ void arch_mm_init(struct mm *mm)
 	local_flush_tlb_all();
 }
 
-void arch_process_activate(struct process *process)
+void arch_process_activate(struct process *process, bool flush_tlb)
 {
 	/* Deactivate VMM */
 	if (has_hypervisor())
@@ -65,11 +65,10 @@ void arch_process_activate(struct process *process)
 	switch_mmu_satp(process->mm.asid, v2p(process->mm.page_table));
 
 	/*
-	 * A process without its own ASID shares ASID 0 with every other
-	 * untagged process, so its predecessor's user translations must be
-	 * flushed here - there is no tag to keep them apart.
+	 * Flush after the switch, so that nothing of the previous address
+	 * space can be walked in afterwards under a recycled or shared ASID.
 	 */
-	if (!process->mm.asid)
+	if (flush_tlb)
 		local_flush_tlb_all();
 
 	asm volatile("fence.i");
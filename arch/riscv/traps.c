@@ -78,6 +78,8 @@ void arch_handle_irq(struct registers *regs, u64 scause)
 
 		case IRQ_S_EXT:
 			irqchip_fn->handle_irq();
+			/* A device might have woken up a preempting task */
+			prepare_user = this_per_cpu()->schedule;
 			break;
 
 		default:
@@ -37,12 +37,13 @@ static inline struct sbiret handle_sbi_time(unsigned long fid, unsigned long a0)
 		case SBI_EXT_TIME_SET_TIMER:
 			timer_ticks_to_time(a0, &ts);
 			current_task()->vmachine.vregs.hvip &= ~VIE_TIE;
-			if (a0 != (unsigned long)-1)
-				task_sleep_until(current_task(), &ts);
-			else
-				task_cancel_timer(current_task());
 			ret.error = 0;
 			ret.value = 0;
+			if (a0 != (unsigned long)-1) {
+				if (task_sleep_until(current_task(), &ts))
+					ret.error = SBI_ERR_FAILED;
+			} else
+				task_cancel_timer(current_task());
 			break;
 
 		default:
@@ -50,6 +50,12 @@ static inline void regs_set_retval(struct registers *r, unsigned long val)
 	r->usr[0] = val;
 }
 
+/* Rewind to the syscall instruction. Its arguments are still in place. */
+static inline void regs_restart_syscall(struct registers *r)
+{
+	r->pc -= 4;
+}
+
 static inline void memory_barrier(void)
 {
 	dmb(ish);
@@ -23,7 +23,7 @@
 struct dirent {
 	ino_t d_ino; // unused (for compat)
 	off_t d_off; // unused (for compat)
-	unsigned short d_reclen; // unused (for compat)
+	unsigned short d_reclen;
 	unsigned char d_type;
 	char d_name[];
 };
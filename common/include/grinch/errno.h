@@ -18,6 +18,7 @@
 
 #define EPERM		1
 #define ENOENT		2
+#define ESRCH		3
 #define EIO		5
 #define E2BIG		7
 #define EBADF		9
@@ -25,6 +26,7 @@
 #define EAGAIN		11
 #define EWOULDBLOCK	EAGAIN
 #define ENOMEM		12
+#define EACCES		13
 #define EFAULT		14
 #define EBUSY		16
 #define EEXIST		17
@@ -32,8 +34,10 @@
 #define ENOTDIR		20
 #define EISDIR		21
 #define EINVAL		22
+#define EMFILE		24
 #define EFBIG		27
 #define EROFS		30
+#define EPIPE		32
 #define ERANGE		34
 #define ENOSYS		38
 #define ENAMETOOLONG	78
@@ -0,0 +1,28 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _GRINCH_POLL_ABI_H
+#define _GRINCH_POLL_ABI_H
+
+#define POLLIN		0x001
+#define POLLOUT		0x004
+#define POLLERR		0x008
+#define POLLHUP		0x010
+#define POLLNVAL	0x020
+
+struct pollfd {
+	int fd;
+	short events;
+	short revents;
+};
+
+#endif /* _GRINCH_POLL_ABI_H */
@@ -0,0 +1,26 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _GRINCH_SCHED_ABI_H
+#define _GRINCH_SCHED_ABI_H
+
+#define SCHED_OTHER		0
+#define SCHED_FIFO		1
+
+#define SCHED_FIFO_PRIO_MIN	1
+#define SCHED_FIFO_PRIO_MAX	99
+
+struct sched_param {
+	int sched_priority;
+};
+
+#endif /* _GRINCH_SCHED_ABI_H */
@@ -17,11 +17,13 @@
 #include <grinch/time_abi.h>
 
 #define S_IFMT 	00170000
+#define S_IFIFO	00010000
 #define S_IFREG	00100000
 #define S_IFCHR 00020000
 #define S_IFDIR	00040000
 #define S_IFLNK	00120000
 
+#define S_ISFIFO(m)	(((m) & S_IFMT) == S_IFIFO)
 #define S_ISREG(m)	(((m) & S_IFMT) == S_IFREG)
 #define S_ISCHR(m)	(((m) & S_IFMT) == S_IFCHR)
 #define S_ISDIR(m)	(((m) & S_IFMT) == S_IFDIR)
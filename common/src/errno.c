@@ -17,12 +17,14 @@
 static const char *errnames[] = {
 	ERRNAME(EPERM),
 	ERRNAME(ENOENT),
+	ERRNAME(ESRCH),
 	ERRNAME(EIO),
 	ERRNAME(E2BIG),
 	ERRNAME(EBADF),
 	ERRNAME(ECHILD),
 	ERRNAME(EAGAIN),
 	ERRNAME(ENOMEM),
+	ERRNAME(EACCES),
 	ERRNAME(EFAULT),
 	ERRNAME(EBUSY),
 	ERRNAME(EEXIST),
@@ -30,8 +32,10 @@ static const char *errnames[] = {
 	ERRNAME(ENOTDIR),
 	ERRNAME(EISDIR),
 	ERRNAME(EINVAL),
+	ERRNAME(EMFILE),
 	ERRNAME(EFBIG),
 	ERRNAME(EROFS),
+	ERRNAME(EPIPE),
 	ERRNAME(ERANGE),
 	ERRNAME(ENOSYS),
 	ERRNAME(ENAMETOOLONG),
@@ -31,28 +31,135 @@ int memcmp(const void *dst, const void *src, size_t count)
 	return 0;
 }
 
+/*
+ * Bulk operations work on whole, aligned words, four of them per iteration.
+ * Shorter operations aren't worth the setup and go byte-wise.
+ */
+#define WORD_MASK	(BYTES_PER_LONG - 1)
+#define BULK_BYTES	(4 * BYTES_PER_LONG)
+
+static inline bool word_aligned(const void *p)
+{
+	return !((uintptr_t)p & WORD_MASK);
+}
+
 void *memset(void *s, int c, size_t n)
 {
+	unsigned long pattern, *w;
 	u8 *p = s;
 
+	if (n >= BULK_BYTES) {
+		for (; !word_aligned(p); n--)
+			*p++ = c;
+
+		/* Replicate the byte to all bytes of the word */
+		pattern = (u8)c * (~0UL / 0xff);
+		for (w = (unsigned long *)p; n >= BULK_BYTES;
+		     n -= BULK_BYTES, w += 4) {
+			w[0] = pattern;
+			w[1] = pattern;
+			w[2] = pattern;
+			w[3] = pattern;
+		}
+		for (; n >= BYTES_PER_LONG; n -= BYTES_PER_LONG)
+			*w++ = pattern;
+		p = (u8 *)w;
+	}
+
 	while (n-- > 0)
 		*p++ = c;
 	return s;
 }
 
+/*
+ * Copy words to an aligned destination from a source that is not word
+ * aligned. Only aligned words are loaded, and shifted into place. This only
+ * works on little-endian machines, which all of our architectures are.
+ */
+static void copy_words_shifted(unsigned long *d, const u8 *s, size_t words)
+{
+	unsigned int shift = ((uintptr_t)s & WORD_MASK) * 8;
+	const unsigned long *w;
+	unsigned long lo, hi;
+
+	w = (const unsigned long *)((uintptr_t)s & ~WORD_MASK);
+	lo = *w++;
+	while (words--) {
+		hi = *w++;
+		*d++ = (lo >> shift) | (hi << (BITS_PER_LONG - shift));
+		lo = hi;
+	}
+}
+
+/*
+ * Strictly copies from low to high addresses, so it may also be used for
+ * overlapping moves to lower addresses.
+ */
+static void copy_forward(u8 *d, const u8 *s, size_t n)
+{
+	const unsigned long *sw;
+	unsigned long *dw;
+	size_t words;
+
+	if (n >= BULK_BYTES) {
+		for (; !word_aligned(d); n--)
+			*d++ = *s++;
+
+		words = n / BYTES_PER_LONG;
+		dw = (unsigned long *)d;
+		if (word_aligned(s)) {
+			sw = (const unsigned long *)s;
+			for (; words >= 4; words -= 4, dw += 4, sw += 4) {
+				dw[0] = sw[0];
+				dw[1] = sw[1];
+				dw[2] = sw[2];
+				dw[3] = sw[3];
+			}
+			while (words--)
+				*dw++ = *sw++;
+		} else
+			copy_words_shifted(dw, s, words);
+
+		words = n / BYTES_PER_LONG;
+		d += words * BYTES_PER_LONG;
+		s += words * BYTES_PER_LONG;
+		n -= words * BYTES_PER_LONG;
+	}
+
+	while (n-- > 0)
+		*d++ = *s++;
+}
+
 void *memmove(void *dst, const void *src, size_t count)
 {
-	char *a = dst;
-	const char *b = src;
-	if (src!=dst) {
-		if (src > dst)
-			while (count--) *a++ = *b++;
-		else {
-			a += count - 1;
-			b += count - 1;
-			while (count--) *a-- = *b--;
-		}
+	const unsigned long *sw;
+	unsigned long *dw;
+	const u8 *s;
+	u8 *d;
+
+	if (dst <= src || dst >= src + count) {
+		copy_forward(dst, src, count);
+		return dst;
+	}
+
+	/* Overlapping move to higher addresses: copy backwards */
+	d = dst + count;
+	s = src + count;
+	if (count >= BULK_BYTES &&
+	    !(((uintptr_t)d ^ (uintptr_t)s) & WORD_MASK)) {
+		for (; !word_aligned(d); count--)
+			*--d = *--s;
+
+		dw = (unsigned long *)d;
+		sw = (const unsigned long *)s;
+		for (; count >= BYTES_PER_LONG; count -= BYTES_PER_LONG)
+			*--dw = *--sw;
+		d = (u8 *)dw;
+		s = (const u8 *)sw;
 	}
+
+	while (count--)
+		*--d = *--s;
 	return dst;
 }
 
@@ -172,11 +279,7 @@ size_t strnlen(const char *s, size_t n)
 
 void *memcpy(void *dest, const void *src, size_t n)
 {
-	const u8 *s = src;
-	u8 *d = dest;
-
-	while (n-- > 0)
-		*d++ = *s++;
+	copy_forward(dest, src, n);
 	return dest;
 }
 
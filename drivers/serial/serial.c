@@ -20,11 +20,16 @@
 #include <grinch/percpu.h>
 #include <grinch/irqchip.h>
 #include <grinch/mmio.h>
+#include <grinch/panic.h>
 #include <grinch/printk.h>
 #include <grinch/serial.h>
 #include <grinch/vsprintf.h>
 
+#define UART_TX_RINGBUF_SIZE	4096
+
 static unsigned int uart_no;
+static LIST_HEAD(uart_chips);
+static DEFINE_SPINLOCK(uart_chips_lock);
 
 void serial_in(struct uart_chip *c, char ch)
 {
@@ -51,22 +56,152 @@ static u32 reg_in_mmio32(struct uart_chip *chip, unsigned int reg)
 	return mmio_read32(chip->base + reg * 4);
 }
 
-static int serial_rcv(void *_c)
+static inline bool uart_tx_buffered(struct uart_chip *chip)
+{
+	return chip->tx.buf != NULL;
+}
+
+static void uart_tx_irq(struct uart_chip *chip, bool enable)
+{
+	if (chip->tx_irq_on == enable)
+		return;
+
+	chip->driver->tx_irq(chip, enable);
+	chip->tx_irq_on = enable;
+}
+
+/* Busy-wait until the transmitter takes the next byte. Must hold the lock. */
+static void uart_tx_polled(struct uart_chip *chip, unsigned char b)
+{
+	while (chip->driver->is_busy(chip))
+		cpu_relax();
+	chip->driver->write_byte(chip, b);
+}
+
+static inline bool uart_tx_full(struct uart_chip *chip)
+{
+	if (chip->driver->tx_full)
+		return chip->driver->tx_full(chip);
+
+	return chip->driver->is_busy(chip);
+}
+
+/*
+ * Feed the transmitter as long as it is free, and let the TX interrupt
+ * continue if bytes remain. Must hold the lock.
+ */
+static void uart_tx_kick(struct uart_chip *chip)
+{
+	unsigned int sz;
+	char *src;
+
+	for (;;) {
+		while (!uart_tx_full(chip)) {
+			src = ringbuf_read(&chip->tx, &sz);
+			if (!sz)
+				break;
+			chip->driver->write_byte(chip, *src);
+			ringbuf_consume(&chip->tx, 1);
+		}
+
+		if (!ringbuf_count(&chip->tx)) {
+			uart_tx_irq(chip, false);
+			return;
+		}
+
+		if (chip->tx_irq_on)
+			return;
+
+		/*
+		 * The transmitter might have become free before the IRQ was
+		 * enabled. Not every UART raises its interrupt in that case.
+		 */
+		uart_tx_irq(chip, true);
+	}
+}
+
+/* Must hold the lock */
+static void uart_tx_flush(struct uart_chip *chip)
+{
+	unsigned int sz;
+	char *src;
+
+	while ((src = ringbuf_read(&chip->tx, &sz))) {
+		uart_tx_polled(chip, *src);
+		ringbuf_consume(&chip->tx, 1);
+	}
+	uart_tx_irq(chip, false);
+}
+
+void serial_flush(void)
+{
+	struct uart_chip *chip;
+
+	spin_lock(&uart_chips_lock);
+	list_for_each_entry(chip, &uart_chips, chips) {
+		if (!uart_tx_buffered(chip))
+			continue;
+
+		spin_lock(&chip->lock);
+		uart_tx_flush(chip);
+		spin_unlock(&chip->lock);
+	}
+	spin_unlock(&uart_chips_lock);
+}
+
+static int serial_irq(void *_c)
 {
 	struct uart_chip *c = _c;
 	int err;
 
 	err = c->driver->rcv_handler(c);
+	if (err)
+		return err;
 
-	return err;
+	if (uart_tx_buffered(c)) {
+		spin_lock(&c->lock);
+		uart_tx_kick(c);
+		spin_unlock(&c->lock);
+	}
+
+	return 0;
 }
 
+/*
+ * Writers only append to the TX buffer and return, unless it is full. In
+ * that case, the oldest byte is pushed out by polling. On panic, the buffer is
+ * flushed, and everything is written synchronously, as nobody would drain the
+ * buffer any longer.
+ */
 void uart_write_byte(struct uart_chip *chip, unsigned char b)
 {
+	unsigned int sz;
+	char *src;
+
 	spin_lock(&chip->lock);
-	while (chip->driver->is_busy(chip))
-		cpu_relax();
-	chip->driver->write_byte(chip, b);
+	if (!uart_tx_buffered(chip)) {
+		uart_tx_polled(chip, b);
+		goto unlock_out;
+	}
+
+	if (in_panic()) {
+		uart_tx_flush(chip);
+		uart_tx_polled(chip, b);
+		goto unlock_out;
+	}
+
+	if (!ringbuf_space(&chip->tx)) {
+		src = ringbuf_read(&chip->tx, &sz);
+		uart_tx_polled(chip, *src);
+		ringbuf_consume(&chip->tx, 1);
+	}
+	ringbuf_write(&chip->tx, b);
+
+	/* The interrupt already takes care of it */
+	if (!chip->tx_irq_on)
+		uart_tx_kick(chip);
+
+unlock_out:
 	spin_unlock(&chip->lock);
 }
 
@@ -92,6 +227,7 @@ static void __init uart_deinit(struct device *dev)
 	devfs_node_unregister(node);
 	devfs_node_deinit(node);
 
+	ringbuf_free(&c->tx);
 	kfree(c);
 }
 
@@ -155,7 +291,7 @@ int __init uart_probe_generic(struct device *dev)
 	c->irq = irq;
 	if (irq != IRQ_INVALID) {
 		dev_pri(dev, "UART: using IRQ %d\n", irq);
-		err = irq_register_handler(irq, serial_rcv, c);
+		err = irq_register_handler(irq, serial_irq, c);
 		if (err) {
 			dev_pri(dev, "Unable to register IRQ %d (%pe)\n",
 				irq, ERR_PTR(err));
@@ -178,6 +314,13 @@ int __init uart_probe_generic(struct device *dev)
 	if (err)
 		goto error_out;
 
+	/* Without an IRQ, the output remains polled */
+	if (irq != IRQ_INVALID && d->tx_irq) {
+		err = ringbuf_init(&c->tx, UART_TX_RINGBUF_SIZE);
+		if (err)
+			goto error_out;
+	}
+
 	err = devfs_node_register(node);
 	if (err)
 		goto error_out;
@@ -185,6 +328,10 @@ int __init uart_probe_generic(struct device *dev)
 	dev_pri(dev, "Registered as %s\n", node->name);
 	uart_no++;
 
+	spin_lock(&uart_chips_lock);
+	list_add_tail(&c->chips, &uart_chips);
+	spin_unlock(&uart_chips_lock);
+
 	return 0;
 
 error_out:
@@ -18,6 +18,7 @@
 #define UART_DLL		0x0
 #define UART_IER		0x1
 #define  UART_IER_RXEN		(1 << 0)
+#define  UART_IER_THREN		(1 << 1)
 #define UART_DLM		0x1
 #define UART_FCR		0x2 /* out: FCR */
 #define UART_IIR		0x2 /* in: IIR */
@@ -70,6 +71,16 @@ static int uart_8250_init(struct uart_chip *chip)
 	return 0;
 }
 
+static void uart_8250_tx_irq(struct uart_chip *chip, bool enable)
+{
+	u32 ier;
+
+	ier = UART_IER_RXEN;
+	if (enable)
+		ier |= UART_IER_THREN;
+	chip->reg_out(chip, UART_IER, ier);
+}
+
 static bool uart_8250_is_busy(struct uart_chip *chip)
 {
 	return !(chip->reg_in(chip, UART_LSR) & UART_LSR_THRE);
@@ -85,6 +96,7 @@ static const struct uart_driver uart_8250 = {
 	.write_byte = uart_8250_write_byte,
 	.is_busy = uart_8250_is_busy,
 	.rcv_handler = uart_8250_rcv_handler,
+	.tx_irq = uart_8250_tx_irq,
 };
 
 static const struct uart_driver uart_8250_dw = {
@@ -92,6 +104,7 @@ static const struct uart_driver uart_8250_dw = {
 	.write_byte = uart_8250_write_byte,
 	.is_busy = uart_8250_is_busy,
 	.rcv_handler = uart_8250_dw_rcv_handler,
+	.tx_irq = uart_8250_tx_irq,
 };
 
 static const struct of_device_id uart_8250_matches[] = {
@@ -78,6 +78,20 @@ static int apbuart_rcv(struct uart_chip *chip)
 	return 0;
 }
 
+/* Raised whenever a character was transmitted */
+static void apbuart_tx_irq(struct uart_chip *chip, bool enable)
+{
+	struct apbuart *uart = chip->base;
+	u32 cr;
+
+	cr = mmio_read32(&uart->ctrl);
+	if (enable)
+		cr |= UART_CTRL_TI;
+	else
+		cr &= ~UART_CTRL_TI;
+	mmio_write32(&uart->ctrl, cr);
+}
+
 static int apbuart_init(struct uart_chip *chip)
 {
 	struct apbuart *uart = chip->base;
@@ -98,6 +112,7 @@ static const struct uart_driver uart_apbuart = {
 	.write_byte = apbuart_write_byte,
 	.is_busy = apbuart_is_busy,
 	.rcv_handler = apbuart_rcv,
+	.tx_irq = apbuart_tx_irq,
 };
 
 static const struct of_device_id uart_apbuart_matches[] = {
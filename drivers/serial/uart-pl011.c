@@ -46,8 +46,10 @@
 #define UARTCR		0x30
 #define UARTIMSC	0x38
 #define  UARTIMSC_RXIM	(1 << 4)
+#define  UARTIMSC_TXIM	(1 << 5)
 
 #define UARTFR_TXFF	(1 << 5)
+#define UARTFR_RXFE	(1 << 4)
 #define UARTFR_BUSY	(1 << 3)
 
 #define UARTCR_Out2  	(1 << 13)
@@ -78,12 +80,31 @@ static int uart_pl011_rcv_handler(struct uart_chip *chip)
 {
 	unsigned char ch;
 
-	ch = mmio_read32(chip->base + UARTDR);
-	serial_in(chip, ch);
+	/* The interrupt might have been raised by the transmitter */
+	while (!(mmio_read32(chip->base + UARTFR) & UARTFR_RXFE)) {
+		ch = mmio_read32(chip->base + UARTDR);
+		serial_in(chip, ch);
+	}
 
 	return 0;
 }
 
+/*
+ * The FIFOs are disabled. The TX interrupt is then pending as soon as the
+ * holding register is empty, while BUSY remains set until the shift register
+ * sent the byte. It is only cleared by the next write, so the TX buffer must
+ * be drained as long as TXFF is clear, and not only if the UART is idle.
+ */
+static void uart_pl011_tx_irq(struct uart_chip *chip, bool enable)
+{
+	u16 imsc;
+
+	imsc = UARTIMSC_RXIM;
+	if (enable)
+		imsc |= UARTIMSC_TXIM;
+	mmio_write16(chip->base + UARTIMSC, imsc);
+}
+
 static bool uart_pl011_is_busy(struct uart_chip *chip)
 {
 	/* FIFO full or busy */
@@ -91,6 +112,11 @@ static bool uart_pl011_is_busy(struct uart_chip *chip)
 		(UARTFR_TXFF | UARTFR_BUSY)) != 0;
 }
 
+static bool uart_pl011_tx_full(struct uart_chip *chip)
+{
+	return !!(mmio_read32(chip->base + UARTFR) & UARTFR_TXFF);
+}
+
 static void uart_pl011_write_byte(struct uart_chip *chip, unsigned char c)
 {
 	mmio_write32(chip->base + UARTDR, c);
@@ -100,7 +126,9 @@ static const struct uart_driver uart_pl011 = {
 	.init = uart_pl011_init,
 	.write_byte = uart_pl011_write_byte,
 	.is_busy = uart_pl011_is_busy,
+	.tx_full = uart_pl011_tx_full,
 	.rcv_handler = uart_pl011_rcv_handler,
+	.tx_irq = uart_pl011_tx_irq,
 };
 
 static const struct of_device_id uart_pl011_matches[] = {
@@ -11,6 +11,7 @@
  */
 
 #include <grinch/errno.h>
+#include <grinch/irqchip.h>
 #include <grinch/serial.h>
 
 #define UARTLITE_RX		0x0
@@ -18,24 +19,41 @@
 #define UARTLITE_STATUS		0x8
 #define UARTLITE_CTRL		0xc
 
+#define UARTLITE_STATUS_RX_VALID	(1 << 0)
 #define UARTLITE_STATUS_TX_EMPTY	(1 << 2)
 #define UARTLITE_STATUS_TX_FULL		(1 << 3)
 
+#define UARTLITE_CTRL_INTR_EN		(1 << 4)
+
 static int uart_uartlite_rcv_handler(struct uart_chip *chip)
 {
 	unsigned char ch;
 
-	ch = chip->reg_in(chip, UARTLITE_RX);
-	serial_in(chip, ch);
+	/* The interrupt might have been raised by the transmitter */
+	while (chip->reg_in(chip, UARTLITE_STATUS) & UARTLITE_STATUS_RX_VALID) {
+		ch = chip->reg_in(chip, UARTLITE_RX);
+		serial_in(chip, ch);
+	}
 
 	return 0;
 }
 
 static int uart_uartlite_init(struct uart_chip *chip)
 {
+	if (chip->irq != IRQ_INVALID)
+		chip->reg_out(chip, UARTLITE_CTRL, UARTLITE_CTRL_INTR_EN);
+
 	return 0;
 }
 
+/*
+ * The TX interrupt can't be masked on its own. It is only raised once the
+ * TX FIFO runs empty, and spurious ones do no harm.
+ */
+static void uart_uartlite_tx_irq(struct uart_chip *chip, bool enable)
+{
+}
+
 static bool uart_uartlite_is_busy(struct uart_chip *chip)
 {
 	return !!(chip->reg_in(chip, UARTLITE_STATUS)
@@ -52,6 +70,7 @@ static const struct uart_driver uart_uartlite = {
 	.write_byte = uart_uartlite_write_byte,
 	.is_busy = uart_uartlite_is_busy,
 	.rcv_handler = uart_uartlite_rcv_handler,
+	.tx_irq = uart_uartlite_tx_irq,
 };
 
 static const struct of_device_id uart_uartlite_matches[] = {
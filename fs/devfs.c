@@ -20,9 +20,11 @@
 #include <grinch/fs/util.h>
 #include <grinch/minmax.h>
 #include <grinch/percpu.h>
+#include <grinch/poll_abi.h>
 #include <grinch/printk.h>
 #include <grinch/task.h>
 #include <grinch/uaccess.h>
+#include <grinch/wait.h>
 
 // FIXME: We have no reference counting of objects
 
@@ -63,57 +65,66 @@ static const struct devfs_ops dev_null_fops = {
 	.write = dev_zero_write,
 };
 
+/*
+ * Nodes are only registered and unregistered during boot, so the cursor of
+ * the handle, the node that was returned last, stays valid.
+ */
 static int
 devfs_getdents(struct file_handle *handle, struct dirent *udents,
 	       unsigned int size)
 {
 	struct devfs_node *node;
+	struct list_head *pos;
 	struct dirent dent;
-	loff_t i;
-	int err;
+	int err, filled;
 
 	spin_lock(&devfs_lock);
 
-	i = 0;
-	err = 0;
-	list_for_each_entry(node, &devfs_nodes, nodes) {
-		if (i == handle->position)
-			goto found;
-		i++;
-	}
+	node = handle->cursor;
+	pos = node ? &node->nodes : &devfs_nodes;
 
-	goto unlock_out;
+	err = 0;
+	filled = 0;
+	memset(&dent, 0, sizeof(dent));
+	for (pos = pos->next; pos != &devfs_nodes; pos = pos->next) {
+		node = list_entry(pos, struct devfs_node, nodes);
+		switch (node->type) {
+			case DEVFS_REGULAR:
+			case DEVFS_CHARDEV:
+				dent.d_type = DT_REG;
+				break;
+
+			case DEVFS_SYMLINK:
+				dent.d_type = DT_LNK;
+				break;
+
+			default:
+				dent.d_type = DT_UNKNOWN;
+				break;
+		}
 
-found:
-	i++;
-	switch (node->type) {
-		case DEVFS_REGULAR:
-		case DEVFS_CHARDEV:
-			dent.d_type = DT_REG;
+		err = copy_dirent(udents, handle->flags.is_kernel, &dent,
+				  node->name, size);
+		if (err < 0)
 			break;
 
-		case DEVFS_SYMLINK:
-			dent.d_type = DT_LNK;
-			break;
+		udents = (void *)udents + err;
+		size -= err;
+		filled++;
 
-		default:
-			dent.d_type = DT_UNKNOWN;
-			break;
+		handle->cursor = node;
+		handle->position++;
 	}
 
-	err = copy_dirent(udents, handle->flags.is_kernel, &dent, node->name,
-			  size);
-	if (err)
-		goto unlock_out;
-
-	handle->position = i;
-	err = 1;
-
-unlock_out:
 	spin_unlock(&devfs_lock);
-	return err;
+
+	return filled ? filled : err;
 }
 
+static ssize_t devfs_chardev_read(struct devfs_node *node,
+				  struct file_handle *h, char *buf,
+				  size_t count);
+
 static ssize_t devfs_read(struct file_handle *fh, char *ubuf, size_t count)
 {
 	struct devfs_node *node;
@@ -123,7 +134,7 @@ static ssize_t devfs_read(struct file_handle *fh, char *ubuf, size_t count)
 		node = node->drvdata;
 
 	if (node->type == DEVFS_CHARDEV) {
-		return devfs_chardev_read(current_task(), node, fh, ubuf, count);
+		return devfs_chardev_read(node, fh, ubuf, count);
 	}
 
 	if (!node->fops || !node->fops->read)
@@ -161,51 +172,29 @@ static long devfs_ioctl(struct file *file, unsigned int op, unsigned long arg)
 	return node->fops->ioctl(node, op, arg);
 }
 
-static int
-devfs_register_reader(struct file_handle *fh, char *ubuf, size_t count)
+static unsigned int devfs_poll(struct file_handle *fh, struct task *waiter)
 {
 	struct devfs_node *node;
-	struct wfe_read *reader;
-	struct task *task;
-	int err;
+	unsigned int ret;
 
 	node = fh->fp->drvdata;
-	if (node->type == DEVFS_SYMLINK)
+	if (node && node->type == DEVFS_SYMLINK)
 		node = node->drvdata;
 
-	if (node->type != DEVFS_CHARDEV) {
-		BUG();
-		return -ENOSYS;
-	}
-
-	task = current_task();
-	if (task->wfe.type != WFE_NONE)
-		BUG();
+	/* Only character devices may block */
+	if (!node || node->type != DEVFS_CHARDEV)
+		return POLLIN | POLLOUT;
 
 	spin_lock(&node->lock);
+	ret = POLLOUT;
+	if (ringbuf_count(&node->rb))
+		ret |= POLLIN;
 
-	if (node->reader) {
-		err = -EBUSY;
-		goto unlock_out;
-	}
-
-	task->wfe.type = WFE_READ;
-
-	reader = &task->wfe.read;
-	reader->fh = fh;
-	reader->ubuf = ubuf;
-	reader->count = count;
-
-	node->reader = reader;
-
-	task_set_wfe(task);
-	this_per_cpu()->schedule = true;
-
-	err = 0;
-
-unlock_out:
+	if (waiter)
+		wait_register(waiter, &node->readers);
 	spin_unlock(&node->lock);
-	return err;
+
+	return ret;
 }
 
 static struct devfs_node *devfs_find_node(const char *name)
@@ -256,7 +245,7 @@ static const struct file_operations devfs_fops = {
 	.write = devfs_write,
 	.stat = devfs_stat,
 	.getdents = devfs_getdents,
-	.register_reader = devfs_register_reader,
+	.poll = devfs_poll,
 	.open = devfs_open,
 	.ioctl = devfs_ioctl,
 };
@@ -302,43 +291,28 @@ unlock_out:
 
 void devfs_chardev_write(struct devfs_node *node, char c)
 {
-	struct wfe_read *wfe;
-	struct task *task;
-	ssize_t ret;
-
 	if (node->type != DEVFS_CHARDEV)
 		BUG();
 
 	spin_lock(&node->lock);
 	ringbuf_write(&node->rb, c);
-
-	if (!node->reader) {
-		spin_unlock(&node->lock);
-		return;
-	}
-
-	/* Notify first blocking asynchronous reader */
-	task = container_of(node->reader, struct task, wfe.read);
-	spin_lock(&task->lock);
-	wfe = node->reader;
-	node->reader = NULL;
+	/* Readers fetch the data themselves once they are scheduled */
+	if (wake_up(&node->readers))
+		this_per_cpu()->schedule = true;
 	spin_unlock(&node->lock);
-
-	ret = devfs_chardev_read(task, node, wfe->fh, wfe->ubuf, wfe->count);
-
-	regs_set_retval(&task->regs, ret);
-	task->wfe.type = WFE_NONE;
-	task->state = TASK_RUNNABLE;
-	this_per_cpu()->schedule = true;
-
-	spin_unlock(&task->lock);
 }
 
-ssize_t devfs_chardev_read(struct task *task, struct devfs_node *node,
-			   struct file_handle *h, char *buf, size_t count)
+/*
+ * Any number of tasks may block on a character device. Only one of them is
+ * woken up per event, and it passes the wakeup on if it left data behind.
+ */
+static ssize_t devfs_chardev_read(struct devfs_node *node,
+				  struct file_handle *h, char *buf,
+				  size_t count)
 {
 	unsigned long copied;
 	struct ringbuf *rb;
+	struct task *task;
 	unsigned int cnt;
 	ssize_t ret;
 	char *src;
@@ -352,6 +326,7 @@ ssize_t devfs_chardev_read(struct task *task, struct devfs_node *node,
 	if (h->flags.is_kernel)
 		BUG();
 
+	task = current_task();
 	rb = &node->rb;
 	ret = 0;
 	spin_lock(&node->lock);
@@ -370,10 +345,20 @@ ssize_t devfs_chardev_read(struct task *task, struct devfs_node *node,
 		if (copied != cnt)
 			break;
 	} while (count);
-	spin_unlock(&node->lock);
 
-	if (!ret)
-		return -EWOULDBLOCK;
+	if (ret) {
+		if (ringbuf_count(rb))
+			wake_up(&node->readers);
+	} else if (h->flags.nonblock) {
+		ret = -EWOULDBLOCK;
+	} else {
+		ret = wait_prepare(task, 1);
+		if (!ret) {
+			wait_register_exclusive(task, &node->readers);
+			ret = wait_sleep(task, 0);
+		}
+	}
+	spin_unlock(&node->lock);
 
 	return ret;
 }
@@ -384,7 +369,7 @@ void __init devfs_node_deinit(struct devfs_node *node)
 	if (node->type == DEVFS_CHARDEV)
 		ringbuf_free(&node->rb);
 
-	if (node->reader)
+	if (!list_empty(&node->readers.waiters))
 		BUG();
 }
 
@@ -394,6 +379,7 @@ int __init devfs_node_init(struct devfs_node *node)
 
 	spin_init(&node->lock);
 	INIT_LIST_HEAD(&node->nodes);
+	wait_queue_init(&node->readers);
 
 	err = 0;
 	if (node->type == DEVFS_SYMLINK)
@@ -1,5 +1,6 @@
 FS_OBJS = devfs.o
 FS_OBJS += initrd.o
+FS_OBJS += pipe.o
 FS_OBJS += syscall.o
 FS_OBJS += tmpfs.o
 FS_OBJS += util.o
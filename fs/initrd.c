@@ -18,6 +18,7 @@
 #include <grinch/fs/initrd.h>
 #include <grinch/fs/util.h>
 #include <grinch/gfp.h>
+#include <grinch/hash.h>
 #include <grinch/minmax.h>
 #include <grinch/strtox.h>
 #include <grinch/printk.h>
@@ -38,12 +39,36 @@ struct cpio_header {
 	const void *next_header;
 };
 
-struct cpio_context {
-	struct cpio_header hdr;
-	unsigned int subdir_level;
-	char *pathname;
+/*
+ * The archive is parsed once, when it is mounted. Every entry becomes a node
+ * that is hashed by its path, and directories know their children, so that
+ * open and getdents don't need to walk the archive.
+ */
+struct initrd_node {
+	/* Path within the archive, "." for the root */
+	const char *name;
+	unsigned int name_len;
+	unsigned int hash;
+	unsigned short mode;
+
+	const char *body;
+	unsigned int body_len;
+
+	struct initrd_node *parent;
+	struct initrd_node **children;
+	unsigned int nr_children;
+
+	struct initrd_node *hash_next;
 };
 
+static struct {
+	struct initrd_node *nodes;
+	unsigned int nr_nodes;
+	struct initrd_node **buckets;
+	unsigned int nr_buckets;
+	struct initrd_node *root;
+} cpio_index;
+
 struct initrd initrd;
 
 static int parse_cpio_header(const char *s, struct cpio_header *hdr)
@@ -83,33 +108,150 @@ static int parse_cpio_header(const char *s, struct cpio_header *hdr)
 	return 0;
 }
 
-static int cpio_find_file(const char *pathname, struct cpio_header *hdr)
+/* Lookup the entry name of directory dir. Use the root for full paths. */
+static struct initrd_node *
+cpio_lookup(const struct initrd_node *dir, const char *name, size_t len)
+{
+	unsigned int hash, prefix;
+	struct initrd_node *node;
+
+	if (dir == cpio_index.root) {
+		hash = FNV_OFFSET;
+		prefix = 0;
+	} else {
+		hash = fnv_hash(dir->hash, "/", 1);
+		prefix = dir->name_len + 1;
+	}
+	hash = fnv_hash(hash, name, len);
+
+	node = cpio_index.buckets[hash & (cpio_index.nr_buckets - 1)];
+	for (; node; node = node->hash_next) {
+		if (node->hash != hash || node->name_len != prefix + len)
+			continue;
+
+		if (strncmp(node->name + prefix, name, len))
+			continue;
+
+		if (prefix && (strncmp(node->name, dir->name, prefix - 1) ||
+			       node->name[prefix - 1] != '/'))
+			continue;
+
+		return node;
+	}
+
+	return NULL;
+}
+
+static int cpio_index_build(void)
 {
+	struct initrd_node *node, *parent, **children;
+	struct cpio_header hdr;
+	unsigned int i, slot;
 	const void *this;
+	const char *name;
 	int err;
 
-	this = initrd.vbase;
-	if (!this)
+	if (!initrd.vbase)
 		return -ENOENT;
 
-	/* Skip leading slashes */
-	while (*pathname == '/')
-		pathname++;
+	for (this = initrd.vbase; !parse_cpio_header(this, &hdr);
+	     this = hdr.next_header)
+		cpio_index.nr_nodes++;
 
-	/* If we have the root directory, replace it with "." */
-	if (strlen(pathname) == 0)
-		pathname = ".";
+	cpio_index.nr_buckets = 16;
+	while (cpio_index.nr_buckets < cpio_index.nr_nodes)
+		cpio_index.nr_buckets <<= 1;
 
-	while (1) {
-		err = parse_cpio_header(this, hdr);
-		if (err)
-			return err;
-		this = hdr->next_header;
-		if (!strcmp(hdr->name, pathname))
-			return 0;
+	cpio_index.nodes = kzalloc(cpio_index.nr_nodes * sizeof(*node));
+	cpio_index.buckets = kzalloc(cpio_index.nr_buckets *
+				     sizeof(*cpio_index.buckets));
+	children = kzalloc(cpio_index.nr_nodes * sizeof(*children));
+	if (!cpio_index.nodes || !cpio_index.buckets || !children) {
+		err = -ENOMEM;
+		goto free_out;
+	}
+
+	node = cpio_index.nodes;
+	for (this = initrd.vbase; !parse_cpio_header(this, &hdr);
+	     this = hdr.next_header, node++) {
+		name = hdr.name;
+		if (!strncmp(name, "./", 2))
+			name += 2;
+
+		node->name = name;
+		node->name_len = strlen(name);
+		node->hash = fnv_hash(FNV_OFFSET, name, node->name_len);
+		node->mode = hdr.mode;
+		node->body = hdr.body;
+		node->body_len = hdr.body_len;
+
+		if (!cpio_index.root && !strcmp(name, "."))
+			cpio_index.root = node;
+	}
+
+	if (!cpio_index.root) {
+		err = -ENOENT;
+		goto free_out;
+	}
+
+	/* Insert backwards, so that the first of equal names wins */
+	for (i = cpio_index.nr_nodes; i > 0; i--) {
+		node = &cpio_index.nodes[i - 1];
+		slot = node->hash & (cpio_index.nr_buckets - 1);
+		node->hash_next = cpio_index.buckets[slot];
+		cpio_index.buckets[slot] = node;
 	}
 
-	return -ENOENT;
+	/* Count the children of each directory, ... */
+	for (i = 0; i < cpio_index.nr_nodes; i++) {
+		node = &cpio_index.nodes[i];
+		if (node == cpio_index.root)
+			continue;
+
+		name = strrchr(node->name, '/');
+		if (name)
+			parent = cpio_lookup(cpio_index.root, node->name,
+					     name - node->name);
+		else
+			parent = cpio_index.root;
+
+		/* Entries without their directory are unreachable */
+		if (!parent || !S_ISDIR(parent->mode))
+			continue;
+
+		node->parent = parent;
+		parent->nr_children++;
+	}
+
+	/* ... hand out their slices of the children array, ... */
+	for (i = 0; i < cpio_index.nr_nodes; i++) {
+		node = &cpio_index.nodes[i];
+		node->children = children;
+		children += node->nr_children;
+		node->nr_children = 0;
+	}
+
+	/* ... and fill them in archive order */
+	for (i = 0; i < cpio_index.nr_nodes; i++) {
+		node = &cpio_index.nodes[i];
+		parent = node->parent;
+		if (parent)
+			parent->children[parent->nr_children++] = node;
+	}
+
+	pri("indexed %u entries\n", cpio_index.nr_nodes);
+
+	return 0;
+
+free_out:
+	kfree(children);
+	kfree(cpio_index.buckets);
+	kfree(cpio_index.nodes);
+	cpio_index.nodes = NULL;
+	cpio_index.nr_nodes = 0;
+	cpio_index.root = NULL;
+
+	return err;
 }
 
 static int __init cpio_size(const void *base, size_t *size)
@@ -175,6 +317,28 @@ int __init initrd_init(void)
 	return 0;
 }
 
+/*
+ * The initrd holds a reference on its pages for good: they may be mapped
+ * into processes, but must never be returned to the page allocator.
+ */
+int __init initrd_pin(void)
+{
+	paddr_t page, end;
+	int err;
+
+	if (!initrd.vbase)
+		return 0;
+
+	end = page_up(initrd.pstart + initrd.size);
+	for (page = initrd.pstart & PAGE_MASK; page < end; page += PAGE_SIZE) {
+		err = phys_page_get(page);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 static int initrd_create(struct file *dir, struct file *filep,
 			 const char *name, mode_t mode)
 {
@@ -193,30 +357,26 @@ static int initrd_mkdir(struct file *, struct file *, const char *, mode_t)
 
 static ssize_t initrd_read(struct file_handle *handle, char *buf, size_t count)
 {
-	struct cpio_context *ctx;
-	struct cpio_header *hdr;
+	struct initrd_node *node;
 	unsigned long copied;
 	const void *src;
-	struct file *fp;
 	loff_t *off;
 	size_t sz;
 
-	fp = handle->fp;
 	off = &handle->position;
-	ctx = fp->drvdata;
-	hdr = &ctx->hdr;
+	node = handle->fp->drvdata;
 
-	if (!S_ISREG(hdr->mode))
+	if (!S_ISREG(node->mode))
 		return -EBADF;
 
-	if (*off >= hdr->body_len)
+	if (*off >= node->body_len)
 		return 0;
 
 	if (*off < 0)
 		return -EINVAL;
 
-	src = hdr->body + *off;
-	sz = min((unsigned long long)hdr->body_len - *off, count);
+	src = node->body + *off;
+	sz = min((unsigned long long)node->body_len - *off, count);
 	if (handle->flags.is_kernel) {
 		memcpy(buf, src, sz);
 		copied = sz;
@@ -229,119 +389,82 @@ static ssize_t initrd_read(struct file_handle *handle, char *buf, size_t count)
 	return copied;
 }
 
-static void initrd_close(struct file *fp)
+static const void *initrd_contents(struct file *fp, size_t *size)
 {
-	struct cpio_context *ctx;
+	struct initrd_node *node;
 
-	ctx = fp->drvdata;
-	if (!ctx)
-		return;
+	node = fp->drvdata;
+	if (!S_ISREG(node->mode))
+		return ERR_PTR(-EBADF);
 
-	kfree(ctx->pathname);
-	kfree(ctx);
-}
+	if (size)
+		*size = node->body_len;
 
-static unsigned int get_subdir_level(struct cpio_header *hdr)
-{
-	if (!strcmp(hdr->name, "."))
-		return 0;
-
-	return 1 + strcount(hdr->name, '/');
+	return node->body;
 }
 
 static int
 initrd_getdents(struct file_handle *handle, struct dirent *udents,
 		unsigned int size)
 {
-	const char *entry_name, *prefix;
-	struct cpio_header *hdr, tmp;
-	struct cpio_context *ctx;
-	unsigned int prefix_len;
+	struct initrd_node *dir, *node;
 	struct dirent dent;
-	const void *this;
-	struct file *fp;
-	loff_t off, i;
-	int err;
+	const char *name;
+	int err, filled;
 
-	fp = handle->fp;
-	ctx = fp->drvdata;
-	hdr = &ctx->hdr;
-	if (!S_ISDIR(hdr->mode))
+	dir = handle->fp->drvdata;
+	if (!S_ISDIR(dir->mode))
 		return -ENOTDIR;
 
-	off = handle->position;
-
-	/* Skip n+1 positions */
-	tmp = *hdr;
-	off++;
-	for (i = 0; i < off; i++) {
-		this = tmp.next_header;
-		err = parse_cpio_header(this, &tmp);
-		if (err == -ENOENT) /* end of initrd */
-			return 0;
-		if (err)
-			return err;
-	}
-
-	/* Skip potential subdirs */
-	while (get_subdir_level(&tmp) != (ctx->subdir_level + 1)) {
-		this = tmp.next_header;
-		err = parse_cpio_header(this, &tmp);
-		if (err == -ENOENT) /* end of initrd */
-			return 0;
-		if (err)
-			return err;
-		off++;
-	}
-
-	if (ctx->subdir_level == 0) {
-		prefix = "";
-		prefix_len = 0;
-	} else {
-		prefix = hdr->name;
-		prefix_len = hdr->name_len - 1;
-	}
-
-	if (strncmp(prefix, tmp.name, prefix_len))
-		return 0;
-
-	entry_name = tmp.name + prefix_len;
-	if (*entry_name == '/')
-		entry_name++;
+	if (handle->position < 0)
+		return -EINVAL;
 
-	switch (tmp.mode & S_IFMT) {
-		case S_IFREG:
-			dent.d_type = DT_REG;
+	/* The position is the index of the next child */
+	err = 0;
+	filled = 0;
+	memset(&dent, 0, sizeof(dent));
+	while (handle->position < dir->nr_children) {
+		node = dir->children[handle->position];
+		name = strrchr(node->name, '/');
+		name = name ? name + 1 : node->name;
+
+		switch (node->mode & S_IFMT) {
+			case S_IFREG:
+				dent.d_type = DT_REG;
+				break;
+
+			case S_IFDIR:
+				dent.d_type = DT_DIR;
+				break;
+
+			default:
+				dent.d_type = DT_UNKNOWN;
+				break;
+		}
+
+		err = copy_dirent(udents, handle->flags.is_kernel, &dent, name,
+				  size);
+		if (err < 0)
 			break;
 
-		case S_IFDIR:
-			dent.d_type = DT_DIR;
-			break;
+		udents = (void *)udents + err;
+		size -= err;
+		filled++;
 
-		default:
-			dent.d_type = DT_UNKNOWN;
-			break;
+		handle->position++;
 	}
 
-	err = copy_dirent(udents, handle->flags.is_kernel, &dent, entry_name,
-			  size);
-	if (err)
-		return err;
-
-	handle->position = off;
-	return 1;
+	return filled ? filled : err;
 }
 
 static int initrd_stat(struct file *filep, struct stat *st)
 {
-	struct cpio_context *ctx;
-	struct cpio_header *hdr;
+	struct initrd_node *node;
 
-	ctx = filep->drvdata;
-	hdr = &ctx->hdr;
+	node = filep->drvdata;
 
-	st->st_size = hdr->body_len;
-	st->st_mode = hdr->mode;
+	st->st_size = node->body_len;
+	st->st_mode = node->mode;
 
 	return 0;
 }
@@ -351,75 +474,47 @@ static int initrd_open(struct file *dir, struct file *filep, const char *path);
 static const struct file_operations initrd_fops = {
 	.read = initrd_read,
 	.write = initrd_write,
-	.close = initrd_close,
 	.getdents = initrd_getdents,
 	.mkdir = initrd_mkdir,
 	.stat = initrd_stat,
+	.contents = initrd_contents,
 	.create = initrd_create,
 	.open = initrd_open,
 };
 
-static int _initrd_open(struct file *filep, char *pathname)
+static void initrd_fill(struct file *filep, struct initrd_node *node)
 {
-	struct cpio_context *ctx;
-	struct cpio_header *hdr;
-	int err;
-
-	ctx = kmalloc(sizeof(*ctx));
-	if (!ctx) {
-		err = -ENOMEM;
-		goto pathname_out;
-	}
-
-	filep->drvdata = ctx;
+	filep->drvdata = node;
 	filep->fops = &initrd_fops;
-	hdr = &ctx->hdr;
-	ctx->pathname = pathname;
-
-	err = cpio_find_file(ctx->pathname, hdr);
-	if (err)
-		goto free_out;
-
-	filep->mode = hdr->mode;
-	ctx->subdir_level = get_subdir_level(hdr);
-
-	return 0;
-
-free_out:
-	kfree(ctx);
-
-pathname_out:
-	kfree(pathname);
-	filep->drvdata = NULL;
-
-	return err;
+	filep->mode = node->mode;
 }
 
 static int initrd_open(struct file *dir, struct file *filep, const char *path)
 {
-	struct cpio_context *dctx;
-	char *pathname;
-	size_t len;
-
-	dctx = dir->drvdata;
-	len = strlen(dctx->pathname) + 1 + strlen(path) + 1;
-	pathname = kmalloc(len);
-	if (!pathname)
-		return -ENOMEM;
-	snprintf(pathname, len, "%s/%s", dctx->pathname, path);
-
-	return _initrd_open(filep, pathname);
+	struct initrd_node *node;
+
+	node = cpio_lookup(dir->drvdata, path, strlen(path));
+	if (!node)
+		return -ENOENT;
+
+	initrd_fill(filep, node);
+
+	return 0;
 }
 
 static int initrd_mount(const struct file_system *fs, struct file *dir)
 {
-	char *pathname;
+	int err;
 
-	pathname = kstrdup("");
-	if (!pathname)
-		return -ENOMEM;
+	if (!cpio_index.root) {
+		err = cpio_index_build();
+		if (err)
+			return err;
+	}
+
+	initrd_fill(dir, cpio_index.root);
 
-	return _initrd_open(dir, pathname);
+	return 0;
 }
 
 static const struct file_system_operations fs_ops_initrd = {
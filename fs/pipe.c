@@ -0,0 +1,369 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#define dbg_fmt(x)	"pipe: " x
+
+#include <asm-generic/paging.h>
+
+#include <grinch/alloc.h>
+#include <grinch/errno.h>
+#include <grinch/fs/vfs.h>
+#include <grinch/minmax.h>
+#include <grinch/poll_abi.h>
+#include <grinch/ringbuf.h>
+#include <grinch/syscall.h>
+#include <grinch/task.h>
+#include <grinch/uaccess.h>
+#include <grinch/wait.h>
+
+#define PIPE_SIZE	PAGE_SIZE
+
+/*
+ * Both ends of a pipe are anonymous files that share the pipe. It is freed
+ * once both ends are closed.
+ */
+struct pipe {
+	spinlock_t lock;
+	struct ringbuf rb;
+
+	/* Ends that are still open */
+	bool reader;
+	bool writer;
+
+	/* Wait for data, or for the write end to be closed */
+	struct wait_queue readers;
+	/* Wait for space, or for the read end to be closed */
+	struct wait_queue writers;
+};
+
+static void pipe_free(struct pipe *pipe)
+{
+	ringbuf_free(&pipe->rb);
+	kfree(pipe);
+}
+
+static ssize_t pipe_read(struct file_handle *h, char *ubuf, size_t count)
+{
+	unsigned long copied;
+	struct pipe *pipe;
+	struct task *task;
+	unsigned int cnt;
+	ssize_t ret;
+	char *src;
+
+	if (!count)
+		return 0;
+
+	task = current_task();
+	pipe = h->fp->drvdata;
+
+	ret = 0;
+	spin_lock(&pipe->lock);
+	while (count) {
+		src = ringbuf_read(&pipe->rb, &cnt);
+		if (!cnt)
+			break;
+		cnt = min(cnt, count);
+
+		copied = copy_to_user(task, ubuf, src, cnt);
+		ringbuf_consume(&pipe->rb, copied);
+
+		ubuf += copied;
+		count -= copied;
+		ret += copied;
+		if (copied != cnt) {
+			if (!ret)
+				ret = -EFAULT;
+			break;
+		}
+	}
+
+	if (ret > 0) {
+		wake_up_all(&pipe->writers);
+	} else if (ret == 0 && pipe->writer) {
+		/* A pipe without a write end reads as end of file */
+		if (h->flags.nonblock) {
+			ret = -EWOULDBLOCK;
+		} else {
+			ret = wait_prepare(task, 1);
+			if (!ret) {
+				wait_register(task, &pipe->readers);
+				ret = wait_sleep(task, 0);
+			}
+		}
+	}
+	spin_unlock(&pipe->lock);
+
+	return ret;
+}
+
+/*
+ * Blocking writes complete as a whole. If the pipe runs full, the task sleeps
+ * and the write is restarted. wait.progress remembers what was written so far.
+ */
+static ssize_t
+pipe_write(struct file_handle *h, const char *ubuf, size_t count)
+{
+	unsigned long copied;
+	size_t done, before;
+	struct pipe *pipe;
+	struct task *task;
+	unsigned int cnt;
+	ssize_t ret;
+	char *dst;
+
+	task = current_task();
+	pipe = h->fp->drvdata;
+
+	done = task->wait.progress;
+	task->wait.progress = 0;
+
+	spin_lock(&pipe->lock);
+	if (!pipe->reader) {
+		ret = done ? (ssize_t)done : -EPIPE;
+		goto unlock_out;
+	}
+
+	before = done;
+	ret = 0;
+	while (done < count) {
+		dst = ringbuf_reserve(&pipe->rb, &cnt);
+		if (!cnt)
+			break;
+		cnt = min(cnt, count - done);
+
+		copied = copy_from_user(task, dst, ubuf + done, cnt);
+		ringbuf_produce(&pipe->rb, copied);
+
+		done += copied;
+		if (copied != cnt) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	if (done != before)
+		wake_up_all(&pipe->readers);
+
+	if (done == count || ret) {
+		ret = done ? (ssize_t)done : ret;
+	} else if (h->flags.nonblock) {
+		ret = done ? (ssize_t)done : -EWOULDBLOCK;
+	} else {
+		ret = wait_prepare(task, 1);
+		if (ret) {
+			ret = done ? (ssize_t)done : ret;
+			goto unlock_out;
+		}
+
+		task->wait.progress = done;
+		wait_register(task, &pipe->writers);
+		ret = wait_sleep(task, 0);
+	}
+
+unlock_out:
+	spin_unlock(&pipe->lock);
+	return ret;
+}
+
+static unsigned int pipe_read_poll(struct file_handle *h, struct task *waiter)
+{
+	struct pipe *pipe;
+	unsigned int ret;
+
+	pipe = h->fp->drvdata;
+
+	spin_lock(&pipe->lock);
+	ret = ringbuf_count(&pipe->rb) ? POLLIN : 0;
+	if (!pipe->writer)
+		ret |= POLLHUP;
+
+	if (waiter)
+		wait_register(waiter, &pipe->readers);
+	spin_unlock(&pipe->lock);
+
+	return ret;
+}
+
+static unsigned int pipe_write_poll(struct file_handle *h, struct task *waiter)
+{
+	struct pipe *pipe;
+	unsigned int ret;
+
+	pipe = h->fp->drvdata;
+
+	spin_lock(&pipe->lock);
+	if (!pipe->reader)
+		ret = POLLERR;
+	else
+		ret = ringbuf_space(&pipe->rb) ? POLLOUT : 0;
+
+	if (waiter)
+		wait_register(waiter, &pipe->writers);
+	spin_unlock(&pipe->lock);
+
+	return ret;
+}
+
+static void pipe_read_close(struct file *fp)
+{
+	struct pipe *pipe;
+	bool unused;
+
+	pipe = fp->drvdata;
+
+	spin_lock(&pipe->lock);
+	pipe->reader = false;
+	wake_up_all(&pipe->writers);
+	unused = !pipe->writer;
+	spin_unlock(&pipe->lock);
+
+	if (unused)
+		pipe_free(pipe);
+}
+
+static void pipe_write_close(struct file *fp)
+{
+	struct pipe *pipe;
+	bool unused;
+
+	pipe = fp->drvdata;
+
+	spin_lock(&pipe->lock);
+	pipe->writer = false;
+	wake_up_all(&pipe->readers);
+	unused = !pipe->reader;
+	spin_unlock(&pipe->lock);
+
+	if (unused)
+		pipe_free(pipe);
+}
+
+static int pipe_stat(struct file *fp, struct stat *st)
+{
+	struct pipe *pipe;
+
+	pipe = fp->drvdata;
+
+	st->st_mode = S_IFIFO;
+	spin_lock(&pipe->lock);
+	st->st_size = ringbuf_count(&pipe->rb);
+	spin_unlock(&pipe->lock);
+
+	return 0;
+}
+
+static const struct file_operations pipe_read_fops = {
+	.read = pipe_read,
+	.poll = pipe_read_poll,
+	.close = pipe_read_close,
+	.stat = pipe_stat,
+};
+
+static const struct file_operations pipe_write_fops = {
+	.write = pipe_write,
+	.poll = pipe_write_poll,
+	.close = pipe_write_close,
+	.stat = pipe_stat,
+};
+
+static struct pipe *pipe_alloc(void)
+{
+	struct pipe *pipe;
+	int err;
+
+	pipe = kzalloc(sizeof(*pipe));
+	if (!pipe)
+		return ERR_PTR(-ENOMEM);
+
+	err = ringbuf_init(&pipe->rb, PIPE_SIZE);
+	if (err) {
+		kfree(pipe);
+		return ERR_PTR(err);
+	}
+
+	spin_init(&pipe->lock);
+	wait_queue_init(&pipe->readers);
+	wait_queue_init(&pipe->writers);
+
+	return pipe;
+}
+
+SYSCALL_DEF1(pipe, int __user *, ufds)
+{
+	struct file *rd, *wr;
+	unsigned long copied;
+	struct process *p;
+	struct pipe *pipe;
+	struct task *task;
+	unsigned int fd;
+	int fds[2], nr;
+	long ret;
+
+	pipe = pipe_alloc();
+	if (IS_ERR(pipe))
+		return PTR_ERR(pipe);
+
+	rd = file_alloc_anon(&pipe_read_fops, S_IFIFO, pipe);
+	if (IS_ERR(rd)) {
+		pipe_free(pipe);
+		return PTR_ERR(rd);
+	}
+	pipe->reader = true;
+
+	wr = file_alloc_anon(&pipe_write_fops, S_IFIFO, pipe);
+	if (IS_ERR(wr)) {
+		/* Frees the pipe */
+		file_close(rd);
+		return PTR_ERR(wr);
+	}
+	pipe->writer = true;
+
+	task = current_task();
+	p = &task->process;
+	spin_lock(&task->lock);
+
+	nr = 0;
+	for (fd = 0; fd < MAX_FDS && nr < 2; fd++)
+		if (!p->fds[fd].fp)
+			fds[nr++] = fd;
+
+	if (nr < 2) {
+		ret = -EMFILE;
+		goto close_out;
+	}
+
+	copied = copy_to_user(task, ufds, fds, sizeof(fds));
+	if (copied != sizeof(fds)) {
+		ret = -EFAULT;
+		goto close_out;
+	}
+
+	p->fds[fds[0]] = (struct file_handle) {
+		.fp = rd,
+		.flags.may_read = true,
+	};
+	p->fds[fds[1]] = (struct file_handle) {
+		.fp = wr,
+		.flags.may_write = true,
+	};
+	spin_unlock(&task->lock);
+
+	return 0;
+
+close_out:
+	spin_unlock(&task->lock);
+	file_close(rd);
+	file_close(wr);
+
+	return ret;
+}
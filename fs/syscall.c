@@ -19,11 +19,15 @@
 #include <grinch/fs/vfs.h>
 #include <grinch/fs/util.h>
 #include <grinch/percpu.h>
+#include <grinch/poll_abi.h>
 #include <grinch/printk.h>
 #include <grinch/string.h>
 #include <grinch/syscall.h>
 #include <grinch/task.h>
+#include <grinch/time.h>
+#include <grinch/timer.h>
 #include <grinch/uaccess.h>
+#include <grinch/wait.h>
 
 static struct fs_flags get_flags(int oflag)
 {
@@ -124,6 +128,7 @@ found:
 	process->fds[d].fp = file;
 	process->fds[d].flags = flags;
 	process->fds[d].position = 0;
+	process->fds[d].cursor = NULL;
 
 	ret = d;
 
@@ -139,23 +144,64 @@ SYSCALL_DEF1(close, unsigned int, fd)
 {
 	struct file_handle *handle;
 	struct task *task;
-	long err;
+	struct file *fp;
 
 	task = current_task();
 	spin_lock(&task->lock);
 
 	handle = get_handle(fd);
+	if (IS_ERR(handle)) {
+		spin_unlock(&task->lock);
+		return PTR_ERR(handle);
+	}
+
+	fp = handle->fp;
+	handle->fp = NULL;
+	spin_unlock(&task->lock);
+
+	/* Closing a pipe end wakes up other tasks, see process_close_files */
+	file_close(fp);
+
+	return 0;
+}
+
+SYSCALL_DEF2(dup2, unsigned int, oldfd, unsigned int, newfd)
+{
+	struct file_handle *handle;
+	struct process *process;
+	struct file *replaced;
+	struct task *task;
+	long err;
+
+	if (newfd >= MAX_FDS)
+		return -EBADF;
+
+	task = current_task();
+	process = &task->process;
+	replaced = NULL;
+	spin_lock(&task->lock);
+
+	handle = get_handle(oldfd);
 	if (IS_ERR(handle)) {
 		err = PTR_ERR(handle);
 		goto unlock_out;
 	}
 
-	file_close(handle->fp);
-	handle->fp = NULL;
-	err = 0;
+	err = newfd;
+	if (oldfd == newfd)
+		goto unlock_out;
+
+	replaced = process->fds[newfd].fp;
+	file_dup(handle->fp);
+	process->fds[newfd] = *handle;
 
 unlock_out:
 	spin_unlock(&task->lock);
+
+	/* Must not hold the task's lock, see close */
+	if (replaced)
+		file_close(replaced);
+
 	return err;
 }
 
@@ -182,18 +228,12 @@ SYSCALL_DEF3(read, unsigned int, fd, char __user *, buf, size_t, count)
 	if (!file->fops->read)
 		return -EBADF;
 
+	/* Blocking reads sleep on wait queues and return -ERESTARTSYS */
 	bread = file->fops->read(handle, buf, count);
-	if (bread != -EWOULDBLOCK)
-		return bread;
-
-	/* we have a blocking read */
-	if (handle->flags.nonblock)
+	if (bread == -EWOULDBLOCK && handle->flags.nonblock)
 		return 0;
 
-	if (!file->fops->register_reader)
-		return -EWOULDBLOCK;
-
-	return file->fops->register_reader(handle, buf, count);
+	return bread;
 }
 
 SYSCALL_DEF3(write, unsigned int, fd, const char __user *, buf, size_t, count)
@@ -375,3 +415,94 @@ SYSCALL_DEF3(ioctl, unsigned int, fd, unsigned int, op, unsigned long, arg)
 
 	return file->fops->ioctl(file, op, arg);
 }
+
+static unsigned int poll_handle(struct pollfd *pfd, struct task *waiter)
+{
+	struct file_handle *handle;
+	struct file *file;
+
+	if (pfd->fd < 0)
+		return 0;
+
+	handle = get_handle(pfd->fd);
+	if (IS_ERR(handle))
+		return POLLNVAL;
+
+	/* Files that don't support poll never block */
+	file = handle->fp;
+	if (!file->fops || !file->fops->poll)
+		return POLLIN | POLLOUT;
+
+	return file->fops->poll(handle, waiter);
+}
+
+/*
+ * If nothing is ready, the task waits on the wait queues of all files, and
+ * poll is restarted once any of them wakes it up. A restarted poll keeps the
+ * deadline of the first attempt.
+ */
+SYSCALL_DEF3(poll, struct pollfd __user *, ufds, unsigned int, nfds,
+	     int, timeout)
+{
+	struct pollfd fds[MAX_FDS];
+	struct task *task, *waiter;
+	unsigned long copied;
+	timeu_t deadline;
+	unsigned int i;
+	size_t size;
+	long ret;
+
+	task = current_task();
+	/* Only handed on to a restart, never to the next poll */
+	deadline = task->wait.deadline;
+	task->wait.deadline = 0;
+
+	if (nfds > MAX_FDS)
+		return -EINVAL;
+
+	size = nfds * sizeof(*fds);
+	copied = copy_from_user(task, fds, ufds, size);
+	if (copied != size)
+		return -EFAULT;
+
+	if (!deadline && timeout > 0)
+		deadline = timer_get_wall_ns() + MS_TO_NS((timeu_t)timeout);
+
+	waiter = NULL;
+	if (timeout) {
+		ret = wait_prepare(task, nfds);
+		if (ret)
+			return ret;
+		waiter = task;
+	}
+
+	ret = 0;
+	for (i = 0; i < nfds; i++) {
+		fds[i].revents = poll_handle(&fds[i], waiter) &
+			(fds[i].events | POLLERR | POLLHUP | POLLNVAL);
+		/* No need to wait on the remaining files */
+		if (fds[i].revents) {
+			waiter = NULL;
+			ret++;
+		}
+	}
+
+	if (!ret && timeout &&
+	    (!deadline || timer_get_wall_ns() < deadline)) {
+		ret = wait_sleep(task, deadline);
+		if (ret == -ERESTARTSYS) {
+			task->wait.deadline = deadline;
+			return ret;
+		}
+	}
+
+	wait_finish(task);
+	if (ret < 0)
+		return ret;
+
+	copied = copy_to_user(task, ufds, fds, size);
+	if (copied != size)
+		return -EFAULT;
+
+	return ret;
+}
@@ -15,14 +15,19 @@
 #include <grinch/errno.h>
 #include <grinch/fs/tmpfs.h>
 #include <grinch/fs/util.h>
+#include <grinch/gfp.h>
 #include <grinch/minmax.h>
 #include <grinch/printk.h>
+#include <grinch/slab.h>
 #include <grinch/task.h>
 #include <grinch/uaccess.h>
 
 #define TMPFS_DIR	(1 << 0)
 #define TMPFS_CREATE	(1 << 1)
 
+/* Bounds the page arrays of regular files */
+#define TMPFS_MAX_FILE_SIZE	(1UL << 30)
+
 struct tmpfs_entry {
 	struct list_head files;
 
@@ -30,21 +35,61 @@ struct tmpfs_entry {
 	mode_t mode;
 
 	union {
-		void *raw;
+		/*
+		 * Regular files are stored page by page, so that they can
+		 * grow without being moved. slots is the length of the array.
+		 */
+		struct {
+			void **pages;
+			size_t slots;
+		} data;
 		struct list_head files;
 	} content;
 
-	unsigned int size;
+	size_t size;
 
 	spinlock_t lock;
 };
 
+static DEFINE_KMEM_CACHE(tmpfs_entry_cache, "tmpfs_entry", struct tmpfs_entry);
+
+/* Make room for the pages of a file of the given size. Must hold the lock. */
+static int tmpfs_reserve(struct tmpfs_entry *file, size_t size)
+{
+	void **pages;
+	size_t slots;
+
+	if (size > TMPFS_MAX_FILE_SIZE)
+		return -EFBIG;
+
+	slots = page_up(size) / PAGE_SIZE;
+	if (slots <= file->content.data.slots)
+		return 0;
+
+	/* Double the array, so that appending stays linear */
+	slots = max(slots, file->content.data.slots * 2);
+	pages = kzalloc(slots * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+
+	if (file->content.data.pages) {
+		memcpy(pages, file->content.data.pages,
+		       file->content.data.slots * sizeof(*pages));
+		kfree(file->content.data.pages);
+	}
+
+	file->content.data.pages = pages;
+	file->content.data.slots = slots;
+
+	return 0;
+}
+
 static ssize_t tmpfs_read(struct file_handle *h, char *ubuf, size_t count)
 {
+	size_t pos, left, done, chunk, off;
 	struct tmpfs_entry *file;
+	unsigned long copied;
 	ssize_t ret;
-	size_t left;
-	void *raw;
 
 	if ((ssize_t)count < 0)
 		return -EFBIG;
@@ -60,20 +105,26 @@ static ssize_t tmpfs_read(struct file_handle *h, char *ubuf, size_t count)
 		goto unlock_out;
 	}
 
-	raw = file->content.raw;
-	if (!raw) {
-		ret = 0;
-		goto unlock_out;
-	}
-
 	/* must not happen */
-	if (h->position > file->size)
+	pos = h->position;
+	if (pos > file->size)
 		BUG();
-	left = file->size - h->position;
-
-	ret = copy_to_user(current_task(), ubuf, raw + h->position,
-			   min(count, left));
-	h->position += ret;
+	left = min(count, file->size - pos);
+
+	for (done = 0; done < left; done += copied) {
+		off = (pos + done) % PAGE_SIZE;
+		chunk = min(left - done, PAGE_SIZE - off);
+		copied = copy_to_user(current_task(), ubuf + done,
+				      file->content.data.pages[(pos + done) /
+							       PAGE_SIZE] + off,
+				      chunk);
+		if (copied != chunk) {
+			done += copied;
+			break;
+		}
+	}
+	h->position += done;
+	ret = done;
 
 unlock_out:
 	spin_unlock(&file->lock);
@@ -83,9 +134,10 @@ unlock_out:
 
 static ssize_t tmpfs_write(struct file_handle *h, const char *buf, size_t count)
 {
+	size_t pos, done, chunk, off;
 	struct tmpfs_entry *file;
-	void *tmp_content, *raw;
 	unsigned long copied;
+	void **page;
 	ssize_t ret;
 
 	if (!count)
@@ -105,31 +157,45 @@ static ssize_t tmpfs_write(struct file_handle *h, const char *buf, size_t count)
 		goto unlock_out;
 	}
 
-	loff_t offset = h->position;
+	pos = h->position;
+	if (pos + count < pos || pos + count > TMPFS_MAX_FILE_SIZE) {
+		ret = -EFBIG;
+		goto unlock_out;
+	}
+
+	ret = tmpfs_reserve(file, pos + count);
+	if (ret)
+		goto unlock_out;
 
-	raw = file->content.raw;
-	if (offset + count > file->size) {
-		tmp_content = kmalloc(offset + count);
-		if (!tmp_content){
-			ret = -ENOMEM;
-			goto unlock_out;
+	for (done = 0; done < count; done += copied) {
+		page = &file->content.data.pages[(pos + done) / PAGE_SIZE];
+		if (!*page) {
+			/* Fresh pages are zeroed, files have no holes */
+			*page = zalloc_pages(1);
+			if (!*page) {
+				ret = -ENOMEM;
+				break;
+			}
 		}
 
-		memcpy(tmp_content, raw, offset);
-		kfree(raw);
-		raw = file->content.raw = tmp_content;
-		file->size = offset + count;
+		off = (pos + done) % PAGE_SIZE;
+		chunk = min(count - done, PAGE_SIZE - off);
+		copied = copy_from_user(current_task(), *page + off, buf + done,
+					chunk);
+		if (copied != chunk) {
+			done += copied;
+			ret = -EFAULT;
+			break;
+		}
 	}
 
-	copied = copy_from_user(current_task(), raw + offset, buf, count);
+	/* Short writes report what was written, only empty ones fail */
+	if (done)
+		ret = done;
 
-	if (count == copied)
-		ret = (ssize_t)copied;
-	else {
-		memset(raw + offset + copied, 0, count - copied);
-		ret = -EFAULT;
-	}
-	h->position += copied;
+	h->position += done;
+	if (pos + done > file->size)
+		file->size = pos + done;
 
 unlock_out:
 	spin_unlock(&file->lock);
@@ -137,42 +203,48 @@ unlock_out:
 	return ret;
 }
 
+/*
+ * The cursor of the handle is the entry that was returned last. Entries are
+ * never removed and new ones are appended, so listing resumes right after it.
+ */
 static int tmpfs_getdents(struct file_handle *h, struct dirent *udents,
 			  unsigned int size)
 {
 	struct tmpfs_entry *dir, *file;
-	unsigned int index;
+	struct list_head *pos;
 	struct dirent dent;
-	int err;
+	int err, filled;
 
 	dir = h->fp->drvdata;
 	spin_lock(&dir->lock);
 	if (!S_ISDIR(dir->mode))
 		BUG();
 
-	index = 0;
-	file = NULL;
-	list_for_each_entry(file, &dir->content.files, files) {
-		if (index == h->position)
-			goto found;
-		index++;
-	}
+	file = h->cursor;
+	pos = file ? &file->files : &dir->content.files;
 
 	err = 0;
-	goto unlock_out;
-
-found:
-	dent.d_type = S_ISDIR(file->mode) ? DT_DIR : DT_REG;
-	err = copy_dirent(udents, h->flags.is_kernel, &dent, file->name, size);
-	if (err)
-		return err;
-
-	err = 1;
-	h->position += 1;
+	filled = 0;
+	memset(&dent, 0, sizeof(dent));
+	for (pos = pos->next; pos != &dir->content.files; pos = pos->next) {
+		file = list_entry(pos, struct tmpfs_entry, files);
+		dent.d_type = S_ISDIR(file->mode) ? DT_DIR : DT_REG;
+		err = copy_dirent(udents, h->flags.is_kernel, &dent,
+				  file->name, size);
+		if (err < 0)
+			break;
+
+		udents = (void *)udents + err;
+		size -= err;
+		filled++;
+
+		h->cursor = file;
+		h->position++;
+	}
 
-unlock_out:
 	spin_unlock(&dir->lock);
-	return err;
+
+	return filled ? filled : err;
 }
 
 static struct tmpfs_entry *
@@ -198,7 +270,7 @@ find_create_entry(struct tmpfs_entry *dir, const char *path, unsigned int flags)
 		return ERR_PTR(-ENOENT);
 
 	/* entry shall be created */
-	entry = kzalloc(sizeof(*entry));
+	entry = kmem_cache_zalloc(&tmpfs_entry_cache);
 	if (!entry)
 		return ERR_PTR(-ENOMEM);
 
@@ -206,7 +278,7 @@ find_create_entry(struct tmpfs_entry *dir, const char *path, unsigned int flags)
 
 	entry->name = kstrdup(path);
 	if (!entry->name) {
-		kfree(entry);
+		kmem_cache_free(&tmpfs_entry_cache, entry);
 		return ERR_PTR(-ENOMEM);
 	}
 
@@ -217,7 +289,7 @@ find_create_entry(struct tmpfs_entry *dir, const char *path, unsigned int flags)
 		entry->mode = S_IFREG;
 	}
 
-	list_add(&entry->files, &dir->content.files);
+	list_add_tail(&entry->files, &dir->content.files);
 
 	return entry;
 }
@@ -299,7 +371,7 @@ int tmpfs_new(struct file_system *fs)
 {
 	struct tmpfs_entry *root;
 
-	root = kzalloc(sizeof(*root));
+	root = kmem_cache_zalloc(&tmpfs_entry_cache);
 	if (!root)
 		return -ENOMEM;
 
@@ -12,6 +12,7 @@
 
 #include <grinch/fs/util.h>
 
+#include <grinch/align.h>
 #include <grinch/alloc.h>
 #include <grinch/errno.h>
 #include <grinch/string.h>
@@ -77,18 +78,25 @@ char *pathname_from_user(const char __user *_pathname, bool *must_dir)
 	return kstrdup(pathname);
 }
 
+/*
+ * Copies one directory entry to udent. Records are aligned, so that the next
+ * one may directly follow. Returns the length of the record, or -EINVAL, if it
+ * doesn't fit into size.
+ */
 int copy_dirent(struct dirent __mayuser *udent, bool is_kernel,
 		struct dirent *src, const char *name,
 		unsigned int size)
 {
 	unsigned long copied;
 	struct task *task;
-	size_t nlen;
+	size_t nlen, reclen;
 
 	nlen = strlen(name) + 1;
-	if (size < nlen + sizeof(*src))
+	reclen = ALIGN(sizeof(*src) + nlen, __alignof__(struct dirent));
+	if (size < reclen)
 		return -EINVAL;
 
+	src->d_reclen = reclen;
 	if (is_kernel) {
 		memcpy(udent, src, sizeof(*src));
 		memcpy(udent->d_name, name, nlen);
@@ -102,5 +110,5 @@ int copy_dirent(struct dirent __mayuser *udent, bool is_kernel,
 			return -EFAULT;
 	}
 
-	return 0;
+	return reclen;
 }
@@ -21,10 +21,12 @@
 #include <grinch/fs/util.h>
 #include <grinch/fs/vfs.h>
 #include <grinch/errno.h>
+#include <grinch/hash.h>
 #include <grinch/list.h>
 #include <grinch/panic.h>
 #include <grinch/printk.h>
 #include <grinch/refcount.h>
+#include <grinch/slab.h>
 
 /*
  * When looking up dflc entries, having D_DIR set as flag means:
@@ -41,13 +43,34 @@
 #define D_ISDIR(x)	!!((x) & D_DIR)
 #define D_ISCREATE(x)	!!((x) & D_CREATE)
 
-/* Directory & File Lookup Cache */
+/*
+ * Directory & File Lookup Cache
+ *
+ * Entries are hashed by their parent and their name. Entries that are no
+ * longer referenced stay cached on an LRU list, and so do negative entries
+ * for names that don't exist. dflc_shrink() evicts the oldest unreferenced
+ * leaves beyond DFLC_MAX_UNUSED. Cached children pin their parents.
+ *
+ * A parent's lock protects its children list, and the transitions of its
+ * children's reference counts from and to zero. dflc_cache_lock protects
+ * the hash table and the LRU list, and nests inside of entry locks.
+ */
+#define DFLC_HASH_BITS		8
+#define DFLC_HASH_SIZE		(1 << DFLC_HASH_BITS)
+#define DFLC_MAX_UNUSED		256
+
 struct dflc {
 	struct list_head siblings;
+	struct list_head hash_list;
+	/* Only on the LRU list, if unreferenced */
+	struct list_head lru;
 
 	struct dflc *parent;
 
 	const char *name;
+	unsigned int hash;
+	/* The name does not exist. Never referenced, only cached. */
+	bool negative;
 
 	/* children must only be used, if is_directory = true */
 	struct list_head children;
@@ -72,6 +95,65 @@ static struct dflc root = {
 	.refs = REFCOUNT_INIT(1),
 };
 
+static DEFINE_KMEM_CACHE(dflc_cache, "dflc", struct dflc);
+
+static DEFINE_SPINLOCK(dflc_cache_lock);
+static struct list_head dflc_hash[DFLC_HASH_SIZE];
+static LIST_HEAD(dflc_unused);
+static unsigned int dflc_nr_unused;
+
+static unsigned int
+dflc_hash_name(const struct dflc *parent, const char *name, size_t n)
+{
+	/* Seeded with the parent, as names are only unique within it */
+	return fnv_hash(FNV_OFFSET ^ (unsigned int)(uintptr_t)parent, name, n);
+}
+
+static inline struct list_head *dflc_bucket(unsigned int hash)
+{
+	return &dflc_hash[(hash ^ (hash >> DFLC_HASH_BITS)) % DFLC_HASH_SIZE];
+}
+
+/* Must hold the parent's lock */
+static struct dflc *
+dflc_cache_find(struct dflc *parent, unsigned int hash, const char *name,
+		size_t n)
+{
+	struct dflc *entry, *ret;
+
+	ret = NULL;
+	spin_lock(&dflc_cache_lock);
+	list_for_each_entry(entry, dflc_bucket(hash), hash_list)
+		if (entry->parent == parent && entry->hash == hash &&
+		    !strncmp(entry->name, name, n) && entry->name[n] == '\0') {
+			ret = entry;
+			break;
+		}
+	spin_unlock(&dflc_cache_lock);
+
+	return ret;
+}
+
+/* Must hold the parent's lock */
+static void dflc_park(struct dflc *entry)
+{
+	spin_lock(&dflc_cache_lock);
+	list_add_tail(&entry->lru, &dflc_unused);
+	dflc_nr_unused++;
+	spin_unlock(&dflc_cache_lock);
+}
+
+/* Must hold the parent's lock */
+static void dflc_unpark(struct dflc *entry)
+{
+	spin_lock(&dflc_cache_lock);
+	if (!list_empty(&entry->lru)) {
+		list_del_init(&entry->lru);
+		dflc_nr_unused--;
+	}
+	spin_unlock(&dflc_cache_lock);
+}
+
 static inline void dflc_lock(struct dflc *entry)
 {
 	spin_lock(&entry->lock);
@@ -88,6 +170,18 @@ static struct dflc *_dflc_get(struct dflc *entry)
 	return entry;
 }
 
+/* Reference a cached, possibly unused entry. Must hold the parent's lock */
+static struct dflc *dflc_grab(struct dflc *entry)
+{
+	if (refcount_read(&entry->refs))
+		return _dflc_get(entry);
+
+	dflc_unpark(entry);
+	refcount_set(&entry->refs, 1);
+
+	return entry;
+}
+
 static struct dflc *dflc_get(struct dflc *entry)
 {
 	_dflc_get(entry);
@@ -97,28 +191,92 @@ static struct dflc *dflc_get(struct dflc *entry)
 	return entry;
 }
 
+static void dflc_free(struct dflc *entry)
+{
+	struct file *fp;
+
+	fp = &entry->fp;
+	if (fp->fops && fp->fops->close)
+		fp->fops->close(fp);
+
+	kfree(entry->name);
+	kmem_cache_free(&dflc_cache, entry);
+}
+
 /* decrease refcount of a single entry */
 static void _dflc_put(struct dflc *entry)
 {
 	struct file *fp;
+	bool anon;
 
 	dflc_lock(entry);
 
+	anon = false;
 	fp = &entry->fp;
 	if (refcount_dec_and_test(&entry->refs)) {
-		if (fp->fops && fp->fops->close)
+		/* Stays cached until dflc_shrink() evicts it */
+		if (entry->parent)
+			dflc_park(entry);
+		else if (entry != &root)
+			anon = true;
+		else if (fp->fops && fp->fops->close)
 			fp->fops->close(fp);
+	}
+
+	dflc_unlock(entry);
+
+	/* Anonymous files are gone with their last reference */
+	if (anon)
+		dflc_free(entry);
+}
+
+/* Evict the least recently used leaves. Must not hold any dflc locks. */
+static void dflc_shrink(void)
+{
+	struct dflc *entry, *victim, *parent;
+
+	spin_lock(&dflc_cache_lock);
+	while (dflc_nr_unused > DFLC_MAX_UNUSED) {
+		victim = NULL;
+		list_for_each_entry(entry, &dflc_unused, lru)
+			if (list_empty(&entry->children)) {
+				victim = entry;
+				break;
+			}
+		if (!victim)
+			break;
+
+		/*
+		 * Claim the victim, and take the locks in order. The victim
+		 * pins its parent, but it might be revived by a lookup in the
+		 * meanwhile, and even be parked again. In that case, it's back
+		 * on the LRU list and must stay there.
+		 */
+		list_del_init(&victim->lru);
+		dflc_nr_unused--;
+		parent = victim->parent;
+		spin_unlock(&dflc_cache_lock);
 
-		if (entry->parent) {
-			kfree(entry->name);
-			list_del(&entry->siblings);
-			kfree(entry);
-			entry = NULL;
+		dflc_lock(parent);
+		spin_lock(&dflc_cache_lock);
+		if (refcount_read(&victim->refs) ||
+		    !list_empty(&victim->lru) ||
+		    !list_empty(&victim->children)) {
+			spin_unlock(&dflc_cache_lock);
+			dflc_unlock(parent);
+			spin_lock(&dflc_cache_lock);
+			continue;
 		}
-	}
+		list_del(&victim->hash_list);
+		spin_unlock(&dflc_cache_lock);
 
-	if (entry)
-		dflc_unlock(entry);
+		list_del(&victim->siblings);
+		dflc_unlock(parent);
+
+		dflc_free(victim);
+		spin_lock(&dflc_cache_lock);
+	}
+	spin_unlock(&dflc_cache_lock);
 }
 
 /* recursively release the entry */
@@ -150,6 +308,33 @@ static inline struct dflc *dflc_of(struct file *file)
 	return container_of(file, struct dflc, fp);
 }
 
+/*
+ * Files without a path, e.g., the ends of a pipe. They only live as long as
+ * they are referenced.
+ */
+struct file *file_alloc_anon(const struct file_operations *fops, mode_t mode,
+			     void *drvdata)
+{
+	struct dflc *entry;
+
+	entry = kmem_cache_zalloc(&dflc_cache);
+	if (!entry)
+		return ERR_PTR(-ENOMEM);
+
+	INIT_LIST_HEAD(&entry->siblings);
+	INIT_LIST_HEAD(&entry->hash_list);
+	INIT_LIST_HEAD(&entry->lru);
+	INIT_LIST_HEAD(&entry->children);
+	spin_init(&entry->lock);
+	refcount_set(&entry->refs, 1);
+
+	entry->fp.fops = fops;
+	entry->fp.mode = mode;
+	entry->fp.drvdata = drvdata;
+
+	return &entry->fp;
+}
+
 void file_dup(struct file *file)
 {
 	dflc_get(dflc_of(file));
@@ -161,8 +346,11 @@ void file_close(struct file *file)
 
 	entry = dflc_of(file);
 	dflc_put(entry);
+
+	dflc_shrink();
 }
 
+/* Must hold the parent's lock */
 static void dflc_init(struct dflc *dflc, struct dflc *parent)
 {
 	spin_init(&dflc->lock);
@@ -170,7 +358,12 @@ static void dflc_init(struct dflc *dflc, struct dflc *parent)
 	dflc->fs = parent->fs;
 	list_add(&dflc->siblings, &parent->children);
 	INIT_LIST_HEAD(&dflc->children);
+	INIT_LIST_HEAD(&dflc->lru);
 	refcount_set(&dflc->refs, 1);
+
+	spin_lock(&dflc_cache_lock);
+	list_add(&dflc->hash_list, dflc_bucket(dflc->hash));
+	spin_unlock(&dflc_cache_lock);
 }
 
 /*
@@ -180,58 +373,70 @@ static void dflc_init(struct dflc *dflc, struct dflc *parent)
  * We must arrive here with the parent's lock being held.
  */
 static inline struct dflc *
-dflc_lookup_next(struct dflc *parent, const char *_name, size_t n,
+dflc_lookup_next(struct dflc *parent, const char *name, size_t n,
 		 unsigned int flags)
 {
 	int (*fun)(struct file *, struct file *, const char *, mode_t);
 	bool directory, create;
 	struct dflc *next;
-	char *name;
+	unsigned int hash;
 	int err;
 
-	name = kstrndup(_name, n);
-	if (!name)
-		return ERR_PTR(-ENOMEM);
+	directory = D_ISDIR(flags);
+	create = D_ISCREATE(flags);
 
-	list_for_each_entry(next, &parent->children, siblings)
-		if (!strcmp(next->name, name)) {
-			kfree(name);
-			return _dflc_get(next);
+	/* Hits neither allocate nor ask the file system */
+	hash = dflc_hash_name(parent, name, n);
+	next = dflc_cache_find(parent, hash, name, n);
+	if (next) {
+		if (!next->negative) {
+			if (directory && create)
+				return ERR_PTR(-EEXIST);
+			return dflc_grab(next);
 		}
 
-	next = kzalloc(sizeof *next);
-	if (!next) {
-		kfree(name);
-		return ERR_PTR(-ENOMEM);
+		if (!create)
+			return ERR_PTR(-ENOENT);
+	} else {
+		next = kmem_cache_zalloc(&dflc_cache);
+		if (!next)
+			return ERR_PTR(-ENOMEM);
+
+		next->name = kstrndup(name, n);
+		if (!next->name) {
+			kmem_cache_free(&dflc_cache, next);
+			return ERR_PTR(-ENOMEM);
+		}
+		next->hash = hash;
 	}
-	next->name = name;
 
-	directory = D_ISDIR(flags);
-	create = D_ISCREATE(flags);
+	if (!parent->fp.fops) {
+		err = -ENOSYS;
+		goto err_out;
+	}
 
 	if (directory && create) {
 		fun = parent->fp.fops->mkdir;
 		goto fun_out;
 	}
 
-	if (!parent->fp.fops || !parent->fp.fops->open) {
-		err = -ENOSYS;
-		goto err_free_out;
-	}
-
-	err = parent->fp.fops->open(&parent->fp, &next->fp, next->name);
-	if (!err)
-		goto opened;
+	/* Negative entries are already known not to exist */
+	if (!next->negative) {
+		if (!parent->fp.fops->open) {
+			err = -ENOSYS;
+			goto err_out;
+		}
 
-	if (err != -ENOENT)
-		goto err_free_out;
+		err = parent->fp.fops->open(&parent->fp, &next->fp,
+					    next->name);
+		if (!err)
+			goto opened;
 
-	if (!create)
-		goto err_free_out;
+		if (err != -ENOENT)
+			goto err_out;
 
-	if (!parent->fp.fops) {
-		err = -ENOSYS;
-		goto err_free_out;
+		if (!create)
+			goto negative_out;
 	}
 
 	fun = parent->fp.fops->create;
@@ -239,20 +444,38 @@ dflc_lookup_next(struct dflc *parent, const char *_name, size_t n,
 fun_out:
 	if (!fun) {
 		err = -ENOSYS;
-		goto err_free_out;
+		goto err_out;
 	}
 
 	err = fun(&parent->fp, &next->fp, next->name, 0);
 	if (err)
-		goto err_free_out;
+		goto err_out;
 
 opened:
+	if (next->negative) {
+		next->negative = false;
+		return dflc_grab(next);
+	}
+
 	dflc_init(next, parent);
 	return next;
 
-err_free_out:
-	kfree(next->name);
-	kfree(next);
+negative_out:
+	/* Remember the miss, it is cached like any other unused entry */
+	memset(&next->fp, 0, sizeof(next->fp));
+	next->negative = true;
+	dflc_init(next, parent);
+	refcount_set(&next->refs, 0);
+	dflc_park(next);
+	return ERR_PTR(-ENOENT);
+
+err_out:
+	if (next->negative) {
+		memset(&next->fp, 0, sizeof(next->fp));
+	} else {
+		kfree(next->name);
+		kmem_cache_free(&dflc_cache, next);
+	}
 	return ERR_PTR(err);
 }
 
@@ -266,6 +489,8 @@ dflc_lookup_at(struct file *at, const char *pathname, unsigned int _flags)
 	size_t len;
 	int err;
 
+	dflc_shrink();
+
 	if (pathname[0] == '/') {
 		parent = _dflc_get(&root);
 		pathname++;
@@ -462,6 +687,17 @@ void *vfs_read_file(struct file *file, size_t *len)
 	return ret;
 }
 
+const void *vfs_file_contents(struct file *file, size_t *len)
+{
+	if (!file->fops)
+		return ERR_PTR(-ENOSYS);
+
+	if (!file->fops->contents)
+		return ERR_PTR(-ENOSYS);
+
+	return file->fops->contents(file, len);
+}
+
 static int __init
 vfs_mount(const char *mountpoint, const struct file_system *fs)
 {
@@ -515,8 +751,12 @@ out:
 int __init vfs_init(void)
 {
 	struct file_system *tmpfs;
+	unsigned int i;
 	int err;
 
+	for (i = 0; i < ARRAY_SIZE(dflc_hash); i++)
+		INIT_LIST_HEAD(&dflc_hash[i]);
+
 	err = devfs_init();
 	if (err)
 		return err;
@@ -561,9 +801,10 @@ static void lsof(unsigned int lvl, struct dflc *this)
 	struct dflc *siblings;
 
 	dflc_lock(this);
-	pr("%*s%s%s   (%u%s)\n", lvl * 2, "",
+	pr("%*s%s%s   (%u%s%s)\n", lvl * 2, "",
 	   this->name, S_ISDIR(this->fp.mode) ? "/" : "",
-	   refcount_read(&this->refs), this->mountpoint ? ", mp": "");
+	   refcount_read(&this->refs), this->mountpoint ? ", mp": "",
+	   this->negative ? ", neg" : "");
 	if (S_ISDIR(this->fp.mode))
 		list_for_each_entry(siblings, &this->children, siblings)
 			lsof(lvl + 1, siblings);
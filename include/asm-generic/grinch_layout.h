@@ -45,10 +45,17 @@
 
 #endif
 
+/* The kernel heap grows on demand, up to the direct mapping */
+#define KHEAP_END	DIR_PHYS_BASE
+#define KHEAP_SIZE	(KHEAP_END - KHEAP_BASE)
+
 #define USER_STACK_SIZE		(1 * MIB)
 #define USER_STACK_TOP		USER_END
 #define USER_STACK_BOTTOM	(USER_STACK_TOP - USER_STACK_SIZE)
 
+/* mmap() places mappings top-down, right below the stack */
+#define USER_MMAP_TOP		USER_STACK_BOTTOM
+
 #ifndef __ASSEMBLY__
 
 static inline unsigned char *grinch_base(void)
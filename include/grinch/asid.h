@@ -13,15 +13,22 @@
 #ifndef _ASID_H
 #define _ASID_H
 
+#include <grinch/types.h>
+
+struct mm;
+
 /*
  * Every address space gets its own ASID, so that its translations are
  * tagged apart in the TLB. ASID 0 is shared by the kernel and serves as
- * the untagged fallback: it is returned on hardware without ASIDs, and
- * when the allocator runs dry.
+ * the untagged fallback on hardware without ASIDs.
+ *
+ * ASIDs are handed out lazily on activation. asid_activate() returns true
+ * if this CPU's TLB must be flushed entirely once mm is live, either as the
+ * hardware can't tag address spaces apart, or as ASIDs were recycled.
  */
 int asid_init(void);
-unsigned long asid_alloc(void);
-void asid_free(unsigned long asid);
+bool asid_activate(struct mm *mm);
+void asid_free(struct mm *mm);
 
 /*
  * Number of ASIDs the architecture provides, including the reserved
@@ -55,7 +55,8 @@ struct devfs_node {
 	 */
 	void *drvdata;
 
-	struct wfe_read *reader;
+	/* Tasks that wait for characters to arrive */
+	struct wait_queue readers;
 
 	struct ringbuf rb;
 };
@@ -73,7 +74,5 @@ void devfs_node_deinit(struct devfs_node *node);
 extern const struct file_system devfs;
 
 void devfs_chardev_write(struct devfs_node *node, char c);
-ssize_t devfs_chardev_read(struct task *task, struct devfs_node *node,
-			   struct file_handle *h, char *buf, size_t count);
 
 #endif /* _FS_DEVFS_H */
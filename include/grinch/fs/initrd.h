@@ -26,5 +26,6 @@ extern struct initrd initrd;
 extern const struct file_system initrdfs;
 
 int initrd_init(void);
+int initrd_pin(void);
 
 #endif /* _FS_INITRD_H */
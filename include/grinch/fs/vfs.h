@@ -21,6 +21,7 @@
 
 struct file;
 struct file_system;
+struct task;
 
 struct fs_flags {
 	unsigned char may_read:1;
@@ -35,6 +36,8 @@ struct file_handle {
 	struct file *fp;
 	struct fs_flags flags;
 	loff_t position;
+	/* Where getdents resumes, if position alone doesn't suffice */
+	void *cursor;
 };
 
 struct file_operations {
@@ -42,11 +45,20 @@ struct file_operations {
 	ssize_t (*read)(struct file_handle *, char *ubuf, size_t count);
 	ssize_t (*write)(struct file_handle *, const char *ubuf, size_t count);
 	long (*ioctl)(struct file *file, unsigned int op, unsigned long arg);
+	/*
+	 * Returns the POLL* events that are ready. If waiter is given, the
+	 * waiter must be registered on the wait queue that signals changes.
+	 */
+	unsigned int (*poll)(struct file_handle *, struct task *waiter);
 	/* File + Directory operations */
 	void (*close)(struct file *);
 
-	int (*register_reader)(struct file_handle *h, char *ubuf, size_t count);
 	int (*stat)(struct file *filep, struct stat *st);
+	/*
+	 * Contents of files that are resident and immutable for good. Their
+	 * pages are pinned by the file system and may be mapped directly.
+	 */
+	const void *(*contents)(struct file *filep, size_t *size);
 
 	/* Directory operations */
 	int (*getdents)(struct file_handle *h, struct dirent *udents,
@@ -77,6 +89,10 @@ struct file_system {
 struct file *file_open_at(struct file *at, const char *path);
 struct file *file_ocreate_at(struct file *at, const char *path, bool create);
 
+/* Allocates a file without a path, with one reference */
+struct file *file_alloc_anon(const struct file_operations *fops, mode_t mode,
+			     void *drvdata);
+
 /* Releases the file */
 void file_close(struct file *file);
 
@@ -89,6 +105,7 @@ char *file_realpath(struct file *file);
 int vfs_init(void);
 
 void *vfs_read_file(struct file *file, size_t *len);
+const void *vfs_file_contents(struct file *file, size_t *len);
 int vfs_stat(struct file *file, struct stat *st);
 
 int vfs_mkdir_at(struct file *at, const char *pathname, mode_t mode);
@@ -25,11 +25,34 @@
 #include <grinch/errno.h>
 #include <grinch/string.h>
 
+/* Memory areas are managed by a buddy allocator, up to blocks of 1 << MAX_ORDER pages */
+#define GFP_MAX_ORDER		18
+#define GFP_MEMORY_AREAS	2
+
+/* Per-CPU cache of hot order-0 pages, as page indices of a memory area */
+#define GFP_PCP_BATCH_ORDER	4
+#define GFP_PCP_BATCH		(1 << GFP_PCP_BATCH_ORDER)
+#define GFP_PCP_HIGH		(2 * GFP_PCP_BATCH)
+
+struct gfp_pcp {
+	unsigned int nr;
+	unsigned long pages[GFP_PCP_HIGH];
+};
+
 /* Physical Page allocation */
 int phys_pages_alloc(paddr_t *res, size_t pages, unsigned int alignment);
 int phys_mark_used(paddr_t addr, size_t pages);
 int phys_free_pages(paddr_t from, unsigned int pages);
 
+/*
+ * Sharing of physical pages, e.g., for copy-on-write. A page starts off with
+ * a single owner. Every phys_page_get() adds a further one, and the last
+ * phys_page_put() frees the page.
+ */
+int phys_page_get(paddr_t phys);
+int phys_page_put(paddr_t phys);
+bool phys_page_shared(paddr_t phys);
+
 /* Virtual Page allocation */
 void *alloc_pages_aligned(unsigned int pages, unsigned int alignment);
 
@@ -65,6 +88,7 @@ void *p2v(paddr_t phys);
 /* Initialisation */
 int kernel_mem_init(void);
 int phys_mem_init_fdt(void);
+int phys_refs_init(void);
 
 size_t memory_size(void);
 
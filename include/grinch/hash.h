@@ -0,0 +1,31 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _HASH_H
+#define _HASH_H
+
+#define FNV_OFFSET	2166136261u
+#define FNV_PRIME	16777619u
+
+/*
+ * FNV-1a over n bytes of s. Start with FNV_OFFSET. Hashes can be continued,
+ * so that hashing "a" and continuing with "/b" equals hashing "a/b".
+ */
+static inline unsigned int fnv_hash(unsigned int hash, const char *s, size_t n)
+{
+	while (n--)
+		hash = (hash ^ (unsigned char)*s++) * FNV_PRIME;
+
+	return hash;
+}
+
+#endif /* _HASH_H */
@@ -65,18 +65,34 @@ int paging_discard_init(void);
 
 paddr_t paging_get_phys(page_table_t pt, const void *virt);
 
+/*
+ * Like paging_get_phys(), but additionally reports the size of the page that
+ * maps virt. If virt is not mapped, nothing is mapped in the naturally
+ * aligned region of that size around virt either.
+ */
+paddr_t paging_lookup(page_table_t pt, const void *virt, size_t *size);
+
+/*
+ * Translate virt, and report in len how many bytes, up to max, starting at
+ * virt are mapped physically contiguous. Resolves the run with a single
+ * descent, it ends at the latest at the end of the last-level table.
+ */
+paddr_t paging_get_phys_run(page_table_t pt, const void *virt, size_t max,
+			    size_t *len);
+
 int paging_prealloc(page_table_t pt, const void *vaddr, size_t size);
 
 /*
  * Invalidate [vaddr, vaddr + size) of the address space tagged by asid
- * on every CPU other than this one. The local CPU must be flushed by
- * the caller. On architectures whose TLB maintenance already broadcasts
- * this is a no-op.
+ * on the CPUs in the cpus bitmap, except for this one. The local CPU must
+ * be flushed by the caller. On architectures whose TLB maintenance
+ * already broadcasts this is a no-op.
  */
-void flush_tlb_others_asid(unsigned long asid, const void *vaddr, size_t size);
+void flush_tlb_others_asid(unsigned long *cpus, unsigned long asid,
+			   const void *vaddr, size_t size);
 
-/* Invalidate the entire address space tagged by asid on every CPU. */
-void flush_tlb_asid(unsigned long asid);
+/* Invalidate the entire address space tagged by asid on this and cpus. */
+void flush_tlb_asid(unsigned long *cpus, unsigned long asid);
 
 /* Versatile mapper */
 int map_range(page_table_t pt, const void *vaddr, paddr_t paddr, size_t size,
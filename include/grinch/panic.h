@@ -18,6 +18,7 @@
 #include <grinch/printk.h>
 
 void check_panic(void);
+bool in_panic(void);
 
 void __printf(1, 2) _panic(const char *fmt, ...) __noreturn;
 
@@ -27,6 +27,9 @@
 #include <asm/percpu.h>
 #include <asm/spinlock.h>
 
+#include <grinch/gfp.h>
+#include <grinch/list.h>
+#include <grinch/slab.h>
 #include <grinch/symbols.h>
 #include <grinch/smp.h>
 #include <grinch/time_abi.h>
@@ -50,13 +53,27 @@ struct per_cpu {
 
 	bool primary;
 	bool schedule;
+	/* The current task gives up the CPU to tasks of the same priority */
+	bool yield;
 	bool idling;
 	bool handle_events;
 
 	struct ttp_storage ttp_stor;
 
+	struct gfp_pcp gfp_pcp[GFP_MEMORY_AREAS];
+	struct kmem_magazine slab_mags[SLAB_MAX_CACHES];
+
 	struct {
-		timeu_t next;
+		/* Next periodic tick, -1 if the tick is stopped */
+		timeu_t tick;
+		/* Earliest expiration in the heap */
+		timeu_t event;
+
+		/* Min-heap of tasks that armed a timer on this CPU */
+		spinlock_t lock;
+		struct task **heap;
+		unsigned int nr;
+		unsigned int size;
 	} timer;
 
 	struct {
@@ -67,6 +84,17 @@ struct per_cpu {
 		void *info;
 	} remote_call;
 
+	/*
+	 * Runnable tasks waiting for this CPU. SCHED_FIFO tasks are kept apart,
+	 * ordered by priority, and always go first.
+	 */
+	struct {
+		spinlock_t lock;
+		struct list_head fifo;
+		struct list_head tasks;
+		unsigned int nr_queued;
+	} rq;
+
 	struct task *current_task;
 } __aligned(PAGE_SIZE);
 
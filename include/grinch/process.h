@@ -43,6 +43,7 @@ struct process {
 };
 
 struct task *process_alloc_new(const char *name);
+void process_close_files(struct process *process);
 void process_destroy(struct task *task);
 int process_handle_fault(struct task *task, void __user *addr, bool is_write);
 
@@ -53,7 +54,7 @@ int process_setcwd(struct task *t, const char *pathname);
 
 /* Arch specific routines */
 void arch_mm_init(struct mm *mm);
-void arch_process_activate(struct process *task);
+void arch_process_activate(struct process *task, bool flush_tlb);
 void arch_process_deactivate(void);
 void arch_kinfo_init(struct kinfo *kinfo);
 
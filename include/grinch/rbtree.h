@@ -0,0 +1,52 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+/*
+ * Red-black trees. Like in Linux, the tree doesn't know about keys: users
+ * search for the insertion point on their own, link the new node there with
+ * rb_link_node(), and rebalance with rb_insert_color().
+ */
+
+#ifndef _RBTREE_H
+#define _RBTREE_H
+
+#include <grinch/container_of.h>
+#include <grinch/types.h>
+
+struct rb_node {
+	struct rb_node *parent;
+	struct rb_node *left, *right;
+	bool red;
+};
+
+struct rb_root {
+	struct rb_node *node;
+};
+
+#define RB_ROOT		((struct rb_root) { NULL })
+
+#define rb_entry(ptr, type, member) \
+	container_of(ptr, type, member)
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+				struct rb_node **link)
+{
+	node->parent = parent;
+	node->left = node->right = NULL;
+	node->red = true;
+	*link = node;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+
+#endif /* _RBTREE_H */
@@ -31,6 +31,12 @@ static inline unsigned int ringbuf_count(struct ringbuf *rb)
 	return rb->tail - rb->head;
 }
 
+/* How much bytes can be stored without overwriting old ones? */
+static inline unsigned int ringbuf_space(struct ringbuf *rb)
+{
+	return rb->size - ringbuf_count(rb);
+}
+
 void ringbuf_write(struct ringbuf *rb, char c);
 char *ringbuf_read(struct ringbuf *rb, unsigned int *sz);
 
@@ -39,4 +45,15 @@ static inline void ringbuf_consume(struct ringbuf *rb, unsigned int sz)
 	rb->head += sz;
 }
 
+/*
+ * Contiguous free space at the tail, for writers that fill the buffer in
+ * chunks. ringbuf_produce() commits what was filled in.
+ */
+char *ringbuf_reserve(struct ringbuf *rb, unsigned int *sz);
+
+static inline void ringbuf_produce(struct ringbuf *rb, unsigned int sz)
+{
+	rb->tail += sz;
+}
+
 #endif /* _RINGBUF_H */
@@ -17,6 +17,7 @@
 #include <asm/spinlock.h>
 
 #include <grinch/fs/devfs.h>
+#include <grinch/ringbuf.h>
 #include <grinch/types.h>
 
 struct uart_chip;
@@ -25,10 +26,22 @@ struct uart_driver {
 	int (*init)(struct uart_chip *chip);
 	void (*write_byte)(struct uart_chip *chip, unsigned char b);
 	bool (*is_busy)(struct uart_chip *chip);
+	/*
+	 * Optional: Can the transmitter take no further byte? Used instead
+	 * of is_busy() when draining the TX buffer, if the TX interrupt is
+	 * raised before the transmitter becomes idle.
+	 */
+	bool (*tx_full)(struct uart_chip *chip);
 	int (*rcv_handler)(struct uart_chip *chip);
+	/*
+	 * Enable or disable the interrupt that signals a free transmitter.
+	 * Drivers without it are always polled.
+	 */
+	void (*tx_irq)(struct uart_chip *chip, bool enable);
 };
 
 struct uart_chip {
+	struct list_head chips;
 	const struct uart_driver *driver;
 	void *base;
 	u32 irq;
@@ -38,12 +51,22 @@ struct uart_chip {
 	void (*reg_out)(struct uart_chip *chip, unsigned int reg, u32 value);
 	u32 (*reg_in)(struct uart_chip *chip, unsigned int reg);
 
+	/*
+	 * Pending output, drained by the TX interrupt. Only allocated if the
+	 * chip has an IRQ and the driver supports it.
+	 */
+	struct ringbuf tx;
+	bool tx_irq_on;
+
 	spinlock_t lock;
 };
 
 void uart_write_byte(struct uart_chip *chip, unsigned char b);
 void uart_write_char(struct uart_chip *chip, char c);
 
+/* Synchronously write out the TX buffers of all UARTs */
+void serial_flush(void);
+
 extern const struct devfs_ops serial_fops;
 
 #include <grinch/driver.h>
@@ -0,0 +1,68 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+/*
+ * Object caches for fixed-size kernel objects. Objects are carved from slabs
+ * of pages that come directly from the page allocator, not from the kheap.
+ * Every CPU keeps a small magazine of free objects per cache.
+ */
+
+#include <asm/spinlock.h>
+
+#include <grinch/list.h>
+#include <grinch/types.h>
+
+#define SLAB_MAX_CACHES		8
+#define SLAB_MAGAZINE_SIZE	8
+
+struct kmem_magazine {
+	unsigned int nr;
+	void *objs[SLAB_MAGAZINE_SIZE];
+};
+
+struct kmem_cache {
+	const char *name;
+	size_t size;
+
+	/* Index of the per-CPU magazine, 0 if the cache is not yet set up */
+	unsigned int id;
+	unsigned int order;
+	unsigned int objs;
+
+	spinlock_t lock;
+	/* Slabs with free objects, and completely used ones */
+	struct list_head partial;
+	struct list_head full;
+	unsigned int nr_partial;
+	unsigned int nr_slabs;
+};
+
+/* Caches are defined statically, and set up on their first allocation */
+#define DEFINE_KMEM_CACHE(VAR, NAME, TYPE)				\
+	struct kmem_cache VAR = {					\
+		.name = NAME,						\
+		.size = sizeof(TYPE),					\
+		.lock = SPIN_LOCK_UNLOCKED,				\
+		.partial = LIST_HEAD_INIT(VAR.partial),			\
+		.full = LIST_HEAD_INIT(VAR.full),			\
+	}
+
+void *kmem_cache_alloc(struct kmem_cache *cache);
+void *kmem_cache_zalloc(struct kmem_cache *cache);
+void kmem_cache_free(struct kmem_cache *cache, const void *obj);
+
+void kmem_caches_dump(void);
+
+#endif /* _SLAB_H */
@@ -6,4 +6,8 @@
 char *kstrdup(const char *s);
 char *kstrndup(const char *s, size_t n);
 
+/* Operations on whole, page-aligned pages */
+void clear_page(void *page);
+void copy_page(void *dst, const void *src);
+
 #endif /* _STRING_H */
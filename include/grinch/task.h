@@ -19,8 +19,10 @@
 #include <grinch/list.h>
 #include <grinch/panic.h>
 #include <grinch/process.h>
+#include <grinch/sched_abi.h>
 #include <grinch/types.h>
 #include <grinch/timer.h>
+#include <grinch/wait.h>
 
 #include <grinch/arch/vmm.h>
 
@@ -41,7 +43,7 @@ enum task_wfe {
 	WFE_NONE = 0,
 	WFE_CHILD,
 	WFE_TIMER,
-	WFE_READ,
+	WFE_WAIT,
 };
 
 enum task_type {
@@ -59,13 +61,6 @@ struct wfe_timer {
 	timeu_t expiration;
 };
 
-/* Blocking read from file descriptor */
-struct wfe_read {
-	struct file_handle *fh;
-	char __user *ubuf;
-	size_t count;
-};
-
 struct task {
 	struct list_head tasks;
 	spinlock_t lock;
@@ -80,12 +75,36 @@ struct task {
 	 * second CPU while another one still owns it.
 	 */
 	unsigned long on_cpu;
+	/* The CPU that ran this task last, or TASK_NO_CPU */
+	unsigned long last_cpu;
+
+	/*
+	 * Runnable tasks are queued on exactly one per-CPU run queue. rq_cpu
+	 * names that CPU, or is TASK_NO_CPU if the task is not queued. Both
+	 * are protected by the run queue's lock.
+	 */
+	struct list_head rq;
+	unsigned long rq_cpu;
+
+	/* Scheduling policy, protected by the task's lock */
+	struct {
+		int policy;
+		int prio;
+	} sched;
 
 	struct task *parent;
 	struct list_head children;
 	/* working on siblings always requires the parent's lock */
 	struct list_head sibling;
-	struct list_head timer_list;
+
+	/*
+	 * Position in the timer heap of a CPU, if the task armed a timer.
+	 * cpu is TASK_NO_CPU otherwise. Protected by that CPU's timer lock.
+	 */
+	struct {
+		unsigned long cpu;
+		unsigned int idx;
+	} timer;
 
 	struct {
 		enum task_wfe type;
@@ -93,10 +112,28 @@ struct task {
 		union {
 			struct wfe_child child;
 			struct wfe_timer timer;
-			struct wfe_read read;
 		};
 	} wfe; /* wait for event */
 
+	/*
+	 * Wait queues of a blocking syscall, see wait.c. The syscall is
+	 * restarted once the task is woken up. deadline and progress carry
+	 * state over to the restarted syscall.
+	 */
+	struct {
+		struct waiter *waiters;
+		unsigned int nr;
+		unsigned int max;
+		bool blocked;
+
+		struct waiter single;
+		struct waiter *pool;
+		unsigned int pool_size;
+
+		timeu_t deadline;
+		size_t progress;
+	} wait;
+
 	int exit_code;
 
 	enum task_type type;
@@ -143,10 +180,12 @@ void task_save(struct registers *regs);
 void task_handle_fault(void __user *addr, bool is_write);
 
 void task_set_wfe(struct task *task);
+/* must hold the task's lock */
+void task_wakeup(struct task *task);
 
 /* task timer handling */
-void task_sleep_until(struct task *task, struct timespec *ts);
-void task_sleep_for(struct task *task, struct timespec *ts);
+int task_sleep_until(struct task *task, struct timespec *ts);
+int task_sleep_for(struct task *task, struct timespec *ts);
 void task_cancel_timer(struct task *task);
 
 int task_init(void);
@@ -155,6 +194,9 @@ void prepare_user_return(void);
 
 void task_enqueue(struct task *task);
 
+/* Initialise the run queue of the calling CPU */
+void sched_cpu_init(void);
+
 /* invoke scheduler on all CPUs */
 void sched_all(void);
 
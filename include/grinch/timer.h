@@ -34,8 +34,10 @@ int arch_timer_init(void);
 timeu_t arch_timer_get(void);
 void arch_timer_set(timeu_t ns);
 
-/* task_lock must be held */
-#include <grinch/task.h>
-void timer_update(struct task *task);
+/* Program the next tick, or an earlier expiration */
+void timer_update(timeu_t expiration);
+
+/* Stop or restart the tick, depending on this CPU's run queue */
+void timer_tick_update(void);
 
 #endif /* _TIMER_H */
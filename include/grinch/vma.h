@@ -13,7 +13,10 @@
 #ifndef _VMA_H
 #define _VMA_H
 
+#include <grinch/bitmap.h>
 #include <grinch/list.h>
+#include <grinch/percpu.h>
+#include <grinch/rbtree.h>
 
 #define VMA_FLAG_LAZY	(1 << 0)
 #define VMA_FLAG_USER	(1 << 1)
@@ -21,6 +24,7 @@
 #define VMA_FLAG_W	(1 << 3)
 #define VMA_FLAG_X	(1 << 4)
 #define VMA_FLAG_RW	(VMA_FLAG_R | VMA_FLAG_W)
+#define VMA_FLAG_RWX	(VMA_FLAG_RW | VMA_FLAG_X)
 
 struct vma {
 	char *name;
@@ -28,33 +32,85 @@ struct vma {
 	size_t size; /* in bytes */
 	unsigned int flags;
 
+	/*
+	 * Backing of lazy VMAs by resident file contents: the first size bytes
+	 * of the VMA come from base, the remainder is zero-filled.
+	 */
+	struct {
+		const void *base;
+		size_t size;
+	} file;
+
 	struct list_head vmas;
+	/* Node in the mm's VMA tree, ordered by base */
+	struct rb_node node;
 };
 
 struct mm {
 	/* Holds the user mappings; kernel entries are installed on activation */
 	page_table_t page_table;
 
-	/* Tags this address space's translations; 0 if untaggable */
+	/*
+	 * Tags this address space's translations; 0 if untaggable. Only valid
+	 * within the ASID generation asid_gen, see asid_activate().
+	 */
 	unsigned long asid;
+	unsigned long asid_gen;
 
 	/* list of struct vma */
 	struct list_head vmas;
+
+	/* The same VMAs, indexed for lookups, and the last VMA that was hit */
+	struct rb_root vma_tree;
+	struct vma *vma_cache;
+
+	/* CPUs that ran this address space, and may hold its translations */
+	DECLARE_BITMAP(cpus, MAX_CPUS);
+
+	/* Range whose remote TLB shootdown is batched until mm_flush_tlb() */
+	struct {
+		void *start;
+		void *end;
+	} flush;
 };
 
 struct process;
 
+/* Shared, read-only page of zeroes */
+extern paddr_t zero_page;
+
+int zero_page_init(void);
+
 int kvma_create(struct vma *vma);
+int kvma_grow(struct vma *vma, size_t increase);
 struct vma *uvma_create(struct task *task, void *base, size_t size,
 			unsigned int vma_flags, const char *name);
 void uvmas_destroy(struct process *task);
+void uvma_remove(struct process *p, struct vma *vma);
 
 int uvma_duplicate(struct task *t, struct task *src, struct vma *vma);
-int uvma_resize(const struct process *p, struct vma *vma, size_t size);
+int uvma_resize(struct process *p, struct vma *vma, size_t size);
+int uvma_split(struct process *p, struct vma *vma, void *at);
+int uvma_protect(struct process *p, struct vma *vma,
+		 unsigned int vma_flags);
 
-struct vma *uvma_at(const struct process *p, const void __user *addr);
+struct vma *uvma_at(struct process *p, const void __user *addr);
 bool uvma_collides(const struct process *p, const void __user *base, size_t size);
+/* Iterate over the VMAs that overlap with a range, in ascending order */
+struct vma *
+uvma_first(const struct process *p, const void __user *base, size_t size);
+struct vma *
+uvma_next(const struct process *p, const struct vma *vma, const void *end);
+void __user *uvma_find_free(const struct process *p, size_t size);
+
+int uvma_handle_fault(struct task *t, struct vma *vma, void __user *addr,
+		      bool is_write);
 
-int uvma_handle_fault(struct task *t, struct vma *vma, void __user *addr);
+/*
+ * uvma_remove(), uvma_duplicate() and uvma_protect() only batch the remote
+ * TLB shootdown of the ranges they modify. Callers must issue it with
+ * mm_flush_tlb() once they are done, before the address space runs again.
+ */
+void mm_flush_tlb(struct mm *mm);
 
 #endif /* _VMA_H */
@@ -0,0 +1,86 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#ifndef _WAIT_H
+#define _WAIT_H
+
+#include <asm/spinlock.h>
+
+#include <grinch/list.h>
+#include <grinch/time_abi.h>
+#include <grinch/types.h>
+
+struct task;
+
+/*
+ * A wait queue holds the tasks that wait for an event of an object, e.g., for
+ * data arriving in a pipe. A blocking syscall registers the task on one or
+ * more wait queues and returns -ERESTARTSYS. Waking up the task only makes it
+ * runnable again: the syscall is then restarted, and rechecks its condition.
+ * The actual work, e.g., copying data to the user, is hence always done in
+ * the context of the task, and never by the waker, which might be an IRQ.
+ *
+ * Lock order: object lock -> wait queue lock -> task lock
+ */
+struct wait_queue {
+	spinlock_t lock;
+	struct list_head waiters;
+};
+
+#define WAIT_QUEUE_INIT(name) {					\
+	.lock = SPIN_LOCK_UNLOCKED,				\
+	.waiters = LIST_HEAD_INIT((name).waiters),		\
+}
+
+struct waiter {
+	struct list_head entry;
+	struct wait_queue *wq;
+	struct task *task;
+	/* Protected by the task's lock */
+	bool woken;
+	/* wake_up() only wakes up one of the exclusive waiters */
+	bool exclusive;
+};
+
+static inline void wait_queue_init(struct wait_queue *wq)
+{
+	spin_init(&wq->lock);
+	INIT_LIST_HEAD(&wq->waiters);
+}
+
+/* Provide n waiters for the current syscall of the task */
+int wait_prepare(struct task *task, unsigned int n);
+
+/* Enqueue the task on wq, using one of the prepared waiters */
+void wait_register(struct task *task, struct wait_queue *wq);
+void wait_register_exclusive(struct task *task, struct wait_queue *wq);
+
+/*
+ * Block the task until one of its wait queues, or the deadline, if non-zero,
+ * wakes it up. Returns -ERESTARTSYS, or an error if the timer failed.
+ */
+int wait_sleep(struct task *task, timeu_t deadline);
+
+/* Dequeue the task from all of its wait queues */
+void wait_finish(struct task *task);
+
+/* Called when the task exits. Passes on exclusive wakeups it never consumed. */
+void wait_destroy(struct task *task);
+
+/*
+ * Wake up all non-exclusive waiters and the first exclusive one, or simply
+ * everyone. Both return the number of woken up waiters.
+ */
+unsigned int wake_up(struct wait_queue *wq);
+unsigned int wake_up_all(struct wait_queue *wq);
+
+#endif /* _WAIT_H */
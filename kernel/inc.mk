@@ -10,6 +10,7 @@ KERNEL_OBJS += syscall.o
 KERNEL_OBJS += task.o
 KERNEL_OBJS += timer.o
 KERNEL_OBJS += uaccess.o
+KERNEL_OBJS += wait.o
 
 ifdef CONFIG_GCOV
 KERNEL_OBJS += gcov.o
@@ -34,6 +34,7 @@
 #include <grinch/percpu.h>
 #include <grinch/platform.h>
 #include <grinch/reboot.h>
+#include <grinch/task.h>
 #include <grinch/ttp.h>
 #include <grinch/version.h>
 
@@ -169,6 +170,7 @@ void cmain(unsigned long boot_cpu, paddr_t __fdt)
 	pri("CPU ID: %lu\n", this_cpu_id());
 	this_per_cpu()->primary = true;
 	spin_init(&this_per_cpu()->remote_call.lock);
+	sched_cpu_init();
 
 	err = fdt_init(__fdt);
 	if (err)
@@ -192,6 +194,18 @@ void cmain(unsigned long boot_cpu, paddr_t __fdt)
 	else if (err)
 		goto out;
 
+	err = phys_refs_init();
+	if (err)
+		goto out;
+
+	err = initrd_pin();
+	if (err)
+		goto out;
+
+	err = zero_page_init();
+	if (err)
+		goto out;
+
 	err = kheap_init();
 	if (err)
 		goto out;
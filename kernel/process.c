@@ -105,11 +105,17 @@ static void kinfo_init(struct kinfo *kinfo)
 	arch_kinfo_init(kinfo);
 }
 
-static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
+/*
+ * If the ELF image is resident for good, its segments are demand-paged
+ * straight from it. Otherwise, they are copied.
+ */
+static int process_load_elf(struct task *task, const Elf_Ehdr *ehdr,
+			    size_t len, bool resident,
 			    const struct uenv_array *argv,
 			    const struct uenv_array *envp)
 {
-	void __user *stack_top, __user *tmp, *src, *base;
+	void __user *stack_top, __user *tmp, *base;
+	const void *src;
 	char __user *uargv_string, *uenvp_string;
 	unsigned long argc, copied;
 	unsigned int d, vma_flags;
@@ -117,7 +123,10 @@ static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
 	struct auxv aux[2];
 	struct vma *vma;
 	size_t vma_size;
-	Elf_Phdr *phdr;
+	const Elf_Phdr *phdr;
+
+	if (len < sizeof(*ehdr))
+		return -EINVAL;
 
 	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG))
 		return trace_error(-EINVAL);
@@ -125,7 +134,10 @@ static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
 	if (ehdr->e_machine != ELF_ARCH)
 		return -EINVAL;
 
-	// TODO: Check for out of bounds in ehdr
+	/* Written such that nothing can wrap around */
+	if (ehdr->e_phoff > len ||
+	    ehdr->e_phnum > (len - ehdr->e_phoff) / sizeof(*phdr))
+		return -EINVAL;
 
 	/* check if arguments exceed ARG_MAX size */
 	copied = uenv_sz(argv) + uenv_sz(envp) + sizeof(argc) + sizeof(aux);
@@ -206,10 +218,11 @@ static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
 	}
 
 	/* Load process */
-	phdr = (Elf_Phdr*)((void*)ehdr + ehdr->e_phoff);
+	phdr = (const void *)ehdr + ehdr->e_phoff;
 	task->process.brk.base = NULL;
 	for (d = 0; d < ehdr->e_phnum; d++, phdr++) {
-		if (phdr->p_type != PT_LOAD)
+		/* Empty segments occupy no memory */
+		if (phdr->p_type != PT_LOAD || !phdr->p_memsz)
 			continue;
 
 		base = (void *)(uintptr_t)phdr->p_vaddr;
@@ -222,19 +235,39 @@ static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
 		if (phdr->p_flags & PF_X)
 			vma_flags |= VMA_FLAG_X;
 
-		/* The region must not collide with any other VMA */
+		if (!PTR_PAGE_ALIGNED(base) ||
+		    phdr->p_filesz > phdr->p_memsz ||
+		    phdr->p_offset > len ||
+		    phdr->p_filesz > len - phdr->p_offset)
+			return -EINVAL;
+
 		vma_size = page_up(phdr->p_memsz);
-		if (uvma_collides(&task->process, base, vma_size))
+		if (vma_size < phdr->p_memsz || !is_urange(base, vma_size))
 			return -EINVAL;
 
-		vma = uvma_create(task, base, vma_size, vma_flags, NULL);
-		if (IS_ERR(vma))
-			return PTR_ERR(vma);
+		/* The region must not collide with any other VMA */
+		if (uvma_collides(&task->process, base, vma_size))
+			return -EINVAL;
 
-		src = (void *)ehdr + phdr->p_offset;
-		copied = copy_to_user(task, base, src, phdr->p_filesz);
-		if (copied != phdr->p_filesz)
-			return -ERANGE;
+		src = (const void *)ehdr + phdr->p_offset;
+		if (resident) {
+			vma = uvma_create(task, base, vma_size,
+					  vma_flags | VMA_FLAG_LAZY, NULL);
+			if (IS_ERR(vma))
+				return PTR_ERR(vma);
+
+			vma->file.base = src;
+			vma->file.size = phdr->p_filesz;
+		} else {
+			vma = uvma_create(task, base, vma_size, vma_flags,
+					  NULL);
+			if (IS_ERR(vma))
+				return PTR_ERR(vma);
+
+			copied = copy_to_user(task, base, src, phdr->p_filesz);
+			if (copied != phdr->p_filesz)
+				return -ERANGE;
+		}
 
 		if (base + vma_size > task->process.brk.base)
 			task->process.brk.base = base + vma_size;
@@ -248,37 +281,58 @@ static int process_load_elf(struct task *task, Elf_Ehdr *ehdr,
 int process_from_path(struct task *task, struct file *at, const char *pathname,
 		      struct uenv_array *argv, struct uenv_array *envp)
 {
+	const void *contents;
 	struct file *file;
 	void *elf;
+	size_t len;
 	int err;
 
 	file = file_open_at(at, pathname);
 	if (IS_ERR(file))
 		return PTR_ERR(file);
 
-	elf = vfs_read_file(file, NULL);
+	/* Prefer mapping resident contents over reading a copy */
+	contents = vfs_file_contents(file, &len);
+	if (!IS_ERR(contents)) {
+		file_close(file);
+		return process_load_elf(task, contents, len, true, argv, envp);
+	}
+
+	elf = vfs_read_file(file, &len);
 	file_close(file);
 	if (IS_ERR(elf))
 		return PTR_ERR(elf);
 
-	err = process_load_elf(task, elf, argv, envp);
+	err = process_load_elf(task, elf, len, false, argv, envp);
 	kfree(elf);
 
 	return err;
 }
 
+/*
+ * Closing a file, e.g., the end of a pipe, may wake up other tasks. Must not
+ * hold any task locks.
+ */
+void process_close_files(struct process *process)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAX_FDS; i++)
+		if (process->fds[i].fp) {
+			file_close(process->fds[i].fp);
+			process->fds[i].fp = NULL;
+		}
+}
+
 void process_destroy(struct task *task)
 {
 	struct process *process;
-	unsigned int i;
 
 	if (task->type != GRINCH_PROCESS)
 		BUG();
 
 	process = &task->process;
-	for (i = 0; i < MAX_FDS; i++)
-		if (process->fds[i].fp)
-			file_close(process->fds[i].fp);
+	process_close_files(process);
 
 	uvmas_destroy(process);
 
@@ -297,7 +351,7 @@ void process_destroy(struct task *task)
 		free_pages(process->mm.page_table, 1);
 	}
 
-	asid_free(process->mm.asid);
+	asid_free(&process->mm);
 }
 
 struct task *process_alloc_new(const char *name)
@@ -311,15 +365,15 @@ struct task *process_alloc_new(const char *name)
 	task->type = GRINCH_PROCESS;
 	task->process.mm.page_table = zalloc_pages(1);
 	if (!task->process.mm.page_table) {
-		kfree(task);
+		task_put(task);
 		return ERR_PTR(-ENOMEM);
 	}
 
-	task->process.mm.asid = asid_alloc();
-
 	arch_mm_init(&task->process.mm);
 
 	INIT_LIST_HEAD(&task->process.mm.vmas);
+	task->process.mm.vma_tree = RB_ROOT;
+	task->process.mm.vma_cache = NULL;
 
 	return task;
 }
@@ -335,7 +389,7 @@ int process_handle_fault(struct task *task, void __user *addr, bool is_write)
 		return -ENOENT;
 	}
 
-	err = uvma_handle_fault(task, vma, addr);
+	err = uvma_handle_fault(task, vma, addr, is_write);
 	if (err) {
 		pr_warn("PID %d: Unable to handle fault: %pe\n",
 			task->pid, ERR_PTR(err));
@@ -375,6 +429,7 @@ static long _sys_execve(const char __user *_pathname,
 	task_set_name(this, name);
 
 	uvmas_destroy(process);
+	mm_flush_tlb(&process->mm);
 	process->brk.base = NULL;
 	process->brk.vma = NULL;
 
@@ -471,13 +526,16 @@ SYSCALL_DEF2(nanosleep, const struct timespec __user *, _req,
 	struct timespec req;
 	unsigned long ret;
 	struct task *t;
+	int err;
 
 	t = current_task();
 	ret = copy_from_user(t, &req, _req, sizeof(req));
 	if (ret != sizeof(req))
 		return -EFAULT;
 
-	task_sleep_for(t, &req);
+	err = task_sleep_for(t, &req);
+	if (err)
+		return err;
 	this_per_cpu()->schedule = true;
 
 	if (rem)
@@ -497,6 +555,7 @@ SYSCALL_DEF1(exit, long, errno)
 SYSCALL_DEF0(sched_yield)
 {
 	this_per_cpu()->schedule = true;
+	this_per_cpu()->yield = true;
 
 	return 0;
 }
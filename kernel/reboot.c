@@ -16,6 +16,7 @@
 #include <grinch/panic.h>
 #include <grinch/printk.h>
 #include <grinch/reboot.h>
+#include <grinch/serial.h>
 #include <grinch/syscall.h>
 #include <grinch/reboot_abi.h>
 
@@ -25,6 +26,8 @@ int (*arch_reboot)(void);
 void __noreturn shutdown(int err)
 {
 	pr("Shutdown. Reason: %pe\n", ERR_PTR(err));
+	/* Nobody would drain the console output any longer */
+	serial_flush();
 
 	if (arch_shutdown)
 		err = arch_shutdown(err);
@@ -38,6 +41,7 @@ void __noreturn reboot(void)
 {
 	int err;
 
+	serial_flush();
 	if (arch_reboot)
 		err = arch_reboot();
 	else
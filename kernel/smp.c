@@ -91,6 +91,7 @@ void secondary_cmain(void)
 {
 	arch_secondary_init();
 	irqchip_cpu_init();
+	sched_cpu_init();
 
 	cpu_set_online(this_cpu_id());
 	mb();
@@ -44,6 +44,10 @@ void syscall(unsigned long no, struct syscall_args *args)
 	if (cur->state != TASK_RUNNING)
 		BUG();
 
+	/* The previous syscall blocked, and this is its restart */
+	if (cur->wait.blocked)
+		wait_finish(cur);
+
 	sysfun = NULL;
 	if (no < ARRAY_SIZE(syscalls)) {
 		sysfun = syscalls[no];
@@ -63,12 +67,18 @@ void syscall(unsigned long no, struct syscall_args *args)
 		ret = -ENOSYS;
 
 	/*
-	 * 1. On errors, always set the return value
-	 * 2. We have special treatments for exit,execve,wait
-	 * 3. Syscalls might have killed the task. Check for its existence
+	 * 1. Blocked syscalls are restarted once the task is woken up
+	 * 2. On errors, always set the return value
+	 * 3. We have special treatments for exit,execve,wait
+	 * 4. Syscalls might have killed the task. Check for its existence
 	 */
 sys_out:
 	cur = current_task();
+	if (ret == -ERESTARTSYS) {
+		regs_restart_syscall(&cur->regs);
+		return;
+	}
+
 	if ((ret < 0 ||
 	    !(no == SYS_exit || no == SYS_execve || no == SYS_wait)) && cur)
 		regs_set_retval(&cur->regs, ret);
@@ -14,12 +14,14 @@
 
 #include <grinch/alloc.h>
 #include <grinch/arch.h>
+#include <grinch/asid.h>
 #include <grinch/atomic.h>
 #include <grinch/boot.h>
 #include <grinch/cpu.h>
 #include <grinch/errno.h>
 #include <grinch/panic.h>
 #include <grinch/reboot.h>
+#include <grinch/slab.h>
 #include <grinch/string.h>
 #include <grinch/syscall.h>
 #include <grinch/task.h>
@@ -29,24 +31,167 @@
 struct task *init_task;
 
 static LIST_HEAD(task_list);
-static LIST_HEAD(timer_list);
 
 static DEFINE_SPINLOCK(task_lock);
 
 static atomic_t next_pid = ATOMIC_INIT(1);
 
+static DEFINE_KMEM_CACHE(task_cache, "task", struct task);
+
+void sched_cpu_init(void)
+{
+	struct per_cpu *tpcpu;
+
+	tpcpu = this_per_cpu();
+	spin_init(&tpcpu->rq.lock);
+	INIT_LIST_HEAD(&tpcpu->rq.fifo);
+	INIT_LIST_HEAD(&tpcpu->rq.tasks);
+	tpcpu->rq.nr_queued = 0;
+
+	spin_init(&tpcpu->timer.lock);
+	tpcpu->timer.heap = NULL;
+	tpcpu->timer.nr = 0;
+	tpcpu->timer.size = 0;
+}
+
+/* SCHED_OTHER tasks have rank 0, SCHED_FIFO tasks rank above by priority */
+static inline int task_rank(struct task *task)
+{
+	return task->sched.policy == SCHED_FIFO ? task->sched.prio : 0;
+}
+
+/* must hold the run queue's lock */
+static void __rq_add(struct per_cpu *pcpu, struct task *task)
+{
+	struct task *pos;
+
+	if (task->sched.policy == SCHED_FIFO) {
+		/* Behind all tasks of the same or a higher priority */
+		list_for_each_entry(pos, &pcpu->rq.fifo, rq)
+			if (pos->sched.prio < task->sched.prio)
+				break;
+		list_add_tail(&task->rq, &pos->rq);
+	} else
+		list_add_tail(&task->rq, &pcpu->rq.tasks);
+	pcpu->rq.nr_queued++;
+	task->rq_cpu = pcpu->cpuid;
+}
+
+/* must hold the run queue's lock */
+static void __rq_del(struct per_cpu *pcpu, struct task *task)
+{
+	list_del(&task->rq);
+	INIT_LIST_HEAD(&task->rq);
+	pcpu->rq.nr_queued--;
+	task->rq_cpu = TASK_NO_CPU;
+}
+
+/*
+ * Idle CPUs don't tick in tickless mode and would never look for work to steal.
+ * Wake up one of them.
+ */
+static void rq_kick_idle(void)
+{
+	struct per_cpu *pcpu;
+	unsigned long cpu;
+
+	for_each_online_cpu_except_this(cpu) {
+		pcpu = per_cpu(cpu);
+		if (READ_ONCE(pcpu->idling)) {
+			pcpu->schedule = true;
+			ipi_send(cpu);
+			return;
+		}
+	}
+}
+
+static void rq_enqueue(struct per_cpu *pcpu, struct task *task)
+{
+	struct per_cpu *tpcpu;
+
+	spin_lock(&pcpu->rq.lock);
+	__rq_add(pcpu, task);
+	spin_unlock(&pcpu->rq.lock);
+
+	tpcpu = this_per_cpu();
+	if (pcpu != tpcpu) {
+		/* The remote CPU might have stopped its tick */
+		pcpu->schedule = true;
+		ipi_send(pcpu->cpuid);
+		return;
+	}
+
+	timer_tick_update();
+	if (tpcpu->current_task)
+		rq_kick_idle();
+}
+
+/* Returns the CPU the task was queued on, or TASK_NO_CPU */
+static unsigned long rq_remove(struct task *task)
+{
+	struct per_cpu *pcpu;
+	unsigned long cpu;
+
+retry:
+	cpu = READ_ONCE(task->rq_cpu);
+	if (cpu == TASK_NO_CPU)
+		return cpu;
+
+	/* The task might have been stolen in the meanwhile */
+	pcpu = per_cpu(cpu);
+	spin_lock(&pcpu->rq.lock);
+	if (task->rq_cpu != cpu) {
+		spin_unlock(&pcpu->rq.lock);
+		goto retry;
+	}
+	__rq_del(pcpu, task);
+	spin_unlock(&pcpu->rq.lock);
+
+	return cpu;
+}
+
 static void task_dequeue(struct task *task)
 {
 	spin_lock(&task_lock);
 	list_del(&task->tasks);
 	spin_unlock(&task_lock);
+
+	rq_remove(task);
+}
+
+/*
+ * Pick a CPU for a task that no CPU owns. If this CPU has nothing to do, it
+ * takes the task itself. Otherwise, prefer an idle CPU, starting with the one
+ * that ran the task last. Its caches might still be warm. If all CPUs are
+ * busy, the task stays on this CPU.
+ */
+static unsigned long task_select_cpu(struct task *task)
+{
+	unsigned long cpu;
+
+	if (!this_per_cpu()->current_task)
+		return this_cpu_id();
+
+	cpu = READ_ONCE(task->last_cpu);
+	if (cpu != TASK_NO_CPU && cpu != this_cpu_id() &&
+	    READ_ONCE(per_cpu(cpu)->idling))
+		return cpu;
+
+	for_each_online_cpu_except_this(cpu)
+		if (READ_ONCE(per_cpu(cpu)->idling))
+			return cpu;
+
+	return this_cpu_id();
 }
 
+/* Registers a new, runnable task and queues it, preferably on an idle CPU */
 void task_enqueue(struct task *task)
 {
 	spin_lock(&task_lock);
 	list_add(&task->tasks, &task_list);
 	spin_unlock(&task_lock);
+
+	rq_enqueue(per_cpu(task_select_cpu(task)), task);
 }
 
 static inline void _task_set_wfe(struct task *task)
@@ -79,6 +224,30 @@ static void task_release_cpu(struct task *task)
 	WRITE_ONCE(task->on_cpu, TASK_NO_CPU);
 }
 
+/*
+ * Make a waiting task runnable again. A task that is still owned by a CPU
+ * was woken up before that CPU switched away from it. Queue it there: other
+ * CPUs must not claim it before it is released. Anything else goes to the CPU
+ * that task_select_cpu() picks, which gets a single IPI if it is remote.
+ * SCHED_FIFO tasks preempt lower ranked tasks there.
+ */
+void task_wakeup(struct task *task)
+{
+	struct per_cpu *pcpu;
+	unsigned long cpu;
+
+	task->state = TASK_RUNNABLE;
+
+	cpu = READ_ONCE(task->on_cpu);
+	if (cpu == TASK_NO_CPU)
+		cpu = task_select_cpu(task);
+	pcpu = per_cpu(cpu);
+	rq_enqueue(pcpu, task);
+
+	if (task->sched.policy == SCHED_FIFO)
+		pcpu->schedule = true;
+}
+
 /* must hold the parent's lock */
 static int task_notify_wait(struct task *parent, struct task *child)
 {
@@ -108,7 +277,7 @@ static int task_notify_wait(struct task *parent, struct task *child)
 	 */
 	regs_set_retval(&parent->regs, child->pid);
 	if (parent->state == TASK_WFE)
-		parent->state = TASK_RUNNABLE;
+		task_wakeup(parent);
 
 	task_put(child);
 	parent->wfe.type = WFE_NONE;
@@ -198,6 +367,9 @@ void task_exit(struct task *task, int code)
 	}
 
 	task_cancel_timer(task);
+	wait_destroy(task);
+	if (task->type == GRINCH_PROCESS)
+		process_close_files(&task->process);
 
 	/*
 	 * The task is no scheduleable entry any longer, so remove it from the
@@ -269,7 +441,7 @@ void task_put(struct task *task)
 
 	list_del(&task->sibling);
 
-	kfree(task);
+	kmem_cache_free(&task_cache, task);
 }
 
 static inline pid_t get_new_pid(void)
@@ -286,7 +458,7 @@ struct task *task_alloc_new(const char *name)
 {
 	struct task *task;
 
-	task = kzalloc(sizeof(*task));
+	task = kmem_cache_zalloc(&task_cache);
 	if (!task)
 		return ERR_PTR(-ENOMEM);
 
@@ -297,8 +469,11 @@ struct task *task_alloc_new(const char *name)
 	task->state = TASK_INIT;
 	task->on_cpu = TASK_NO_CPU;
 	task->type = GRINCH_UNDEF;
+	task->rq_cpu = TASK_NO_CPU;
+	task->last_cpu = TASK_NO_CPU;
+	task->timer.cpu = TASK_NO_CPU;
 	INIT_LIST_HEAD(&task->tasks);
-	INIT_LIST_HEAD(&task->timer_list);
+	INIT_LIST_HEAD(&task->rq);
 	INIT_LIST_HEAD(&task->sibling);
 	INIT_LIST_HEAD(&task->children);
 
@@ -309,6 +484,7 @@ static void task_activate(struct task *task)
 {
 	struct per_cpu *tpcpu;
 	struct task *old;
+	bool flush;
 
 	old = current_task();
 	if (old == task) {
@@ -332,13 +508,6 @@ static void task_activate(struct task *task)
 	}
 
 	tpcpu = this_per_cpu();
-	/*
-	 * Only set the task to runnable, if it was running before.
-	 * Through a syscall, it might be set to wait for events.
-	 */
-	if (old && old->state == TASK_RUNNING && old->on_cpu == this_cpu_id())
-		tpcpu->current_task->state = TASK_RUNNABLE;
-
 	/* We are switching away from old; it no longer belongs to this CPU. */
 	if (old)
 		task_release_cpu(old);
@@ -356,6 +525,7 @@ static void task_activate(struct task *task)
 	task->state = TASK_RUNNING;
 	/* Claim ownership; pairs with task_release_cpu() and the pick loop. */
 	WRITE_ONCE(task->on_cpu, this_cpu_id());
+	task->last_cpu = this_cpu_id();
 
 #ifdef CONFIG_DEBUG_OUTPUT
 	pr_dbg("CPU %lu took PID %d\n", this_cpu_id(), task->pid);
@@ -363,7 +533,10 @@ static void task_activate(struct task *task)
 
 	switch (task->type) {
 	case GRINCH_PROCESS:
-		arch_process_activate(&task->process);
+		flush = asid_activate(&task->process.mm);
+		/* Remote shootdowns of the address space must now reach us */
+		__set_bit(this_cpu_id(), task->process.mm.cpus);
+		arch_process_activate(&task->process, flush);
 		break;
 
 	case GRINCH_VMACHINE:
@@ -390,15 +563,83 @@ static bool task_claimable(struct task *task)
 	return owner == TASK_NO_CPU || owner == this_cpu_id();
 }
 
-static void schedule(void)
+/*
+ * Pop the first task off a run queue that this CPU may claim and that ranks at
+ * least min_rank. Usually, this is the head of the queue.
+ */
+static struct task *rq_pop(struct per_cpu *pcpu, int min_rank)
 {
 	struct task *task;
+
+	spin_lock(&pcpu->rq.lock);
+	list_for_each_entry(task, &pcpu->rq.fifo, rq) {
+		if (task_rank(task) < min_rank)
+			break;
+
+		if (task_claimable(task))
+			goto found;
+	}
+
+	if (min_rank == 0)
+		list_for_each_entry(task, &pcpu->rq.tasks, rq)
+			if (task_claimable(task))
+				goto found;
+
+	spin_unlock(&pcpu->rq.lock);
+	return NULL;
+
+found:
+	__rq_del(pcpu, task);
+	spin_unlock(&pcpu->rq.lock);
+	return task;
+}
+
+/* Steal a task from the CPU with the most queued tasks */
+static struct task *rq_steal(void)
+{
+	struct per_cpu *pcpu, *busiest;
+	unsigned int nr, max;
+	unsigned long cpu;
+
+	busiest = NULL;
+	max = 0;
+	for_each_online_cpu_except_this(cpu) {
+		pcpu = per_cpu(cpu);
+		nr = READ_ONCE(pcpu->rq.nr_queued);
+		if (nr > max) {
+			max = nr;
+			busiest = pcpu;
+		}
+	}
+
+	if (!busiest)
+		return NULL;
+
+	return rq_pop(busiest, 0);
+}
+
+static void schedule(void)
+{
+	struct task *cur, *next;
 	struct per_cpu *tpcpu;
+	bool requeued;
+	int min_rank;
 
 	tpcpu = this_per_cpu();
-	spin_lock(&task_lock);
 	tpcpu->schedule = false;
-	task = NULL;
+	cur = tpcpu->current_task;
+
+	/*
+	 * A running SCHED_FIFO task keeps the CPU until it yields, or a task
+	 * of higher priority arrives.
+	 */
+	min_rank = 0;
+	if (cur && cur->state == TASK_RUNNING) {
+		min_rank = task_rank(cur);
+		if (cur->sched.policy == SCHED_FIFO && !tpcpu->yield)
+			min_rank++;
+	}
+	tpcpu->yield = false;
 
 #if 0
 	// Use this chance to allow other VMs to run
@@ -406,59 +647,48 @@ static void schedule(void)
 		hypercall_yield();
 #endif
 
-	if (!tpcpu->current_task)
-		goto begin;
+	next = rq_pop(tpcpu, min_rank);
+	/* Only go for other CPUs' tasks if we would idle otherwise */
+	if (!next && !(cur && cur->state == TASK_RUNNING))
+		next = rq_steal();
 
-	if (list_is_singular(&task_list)) {
-		task = list_first_entry(&task_list, struct task, tasks);
-		spin_lock(&task->lock);
-		if (task->state == TASK_WFE || !task_claimable(task)) {
-			spin_unlock(&task->lock);
-			task = NULL;
-		}
-		goto out;
-	}
-
-	task = tpcpu->current_task;
-	list_for_each_entry_from(task, &task_list, tasks) {
-		spin_lock(&task->lock);
-		if (task->state == TASK_RUNNABLE && task_claimable(task))
-			goto out;
-		spin_unlock(&task->lock);
-	}
-
-begin:
-	if (list_empty(&task_list))
-		goto nothing;
-
-	list_for_each_entry(task, &task_list, tasks) {
-		if (task == tpcpu->current_task)
-			break;
+	if (!next) {
+		/*
+		 * We have nothing to schedule. But is the current task running
+		 * and may continue?
+		 */
+		if (cur && cur->state == TASK_RUNNING)
+			return;
 
-		spin_lock(&task->lock);
-		if (task->state == TASK_RUNNABLE && task_claimable(task))
-			goto out;
-		spin_unlock(&task->lock);
+		task_activate(NULL);
+		return;
 	}
 
-nothing:
 	/*
-	 * We have nothing to schedule. But is the current task running and may
-	 * continue?
+	 * Only requeue the current task, if it was running before. Through a
+	 * syscall, it might be set to wait for events. It remains owned by
+	 * this CPU until task_activate() switched away from it, so idle CPUs
+	 * are only kicked afterwards. They couldn't steal it before.
 	 */
-	if (current_task() && current_task()->state == TASK_RUNNING) {
-		task = current_task();
-		spin_lock(&task->lock);
-	} else
-		task = NULL;
+	requeued = false;
+	if (cur && cur != next) {
+		spin_lock(&cur->lock);
+		if (cur->state == TASK_RUNNING) {
+			cur->state = TASK_RUNNABLE;
+			spin_lock(&tpcpu->rq.lock);
+			__rq_add(tpcpu, cur);
+			spin_unlock(&tpcpu->rq.lock);
+			requeued = true;
+		}
+		spin_unlock(&cur->lock);
+	}
 
-out:
-	/* If task is set, we arrive here with the task->lock hold */
-	task_activate(task);
-	if (task)
-		spin_unlock(&task->lock);
+	spin_lock(&next->lock);
+	task_activate(next);
+	spin_unlock(&next->lock);
 
-	spin_unlock(&task_lock);
+	if (requeued)
+		rq_kick_idle();
 }
 
 SYSCALL_DEF0(fork)
@@ -486,6 +716,7 @@ SYSCALL_DEF0(fork)
 	}
 
 	new->regs = this->regs;
+	new->sched = this->sched;
 	new->parent = this;
 	regs_set_retval(&new->regs, 0);
 
@@ -496,8 +727,12 @@ SYSCALL_DEF0(fork)
 	list_for_each_entry(vma, &this->process.mm.vmas, vmas) {
 		err = uvma_duplicate(new, this, vma);
 		if (err)
-			goto destroy_out;
+			break;
 	}
+	/* Our writable pages just became copy-on-write */
+	mm_flush_tlb(&this->process.mm);
+	if (err)
+		goto destroy_out;
 
 	new->state = TASK_RUNNABLE;
 
@@ -507,7 +742,6 @@ SYSCALL_DEF0(fork)
 	spin_unlock(&new->lock);
 
 	task_enqueue(new);
-	sched_all();
 
 	return new->pid;
 
@@ -525,19 +759,148 @@ destroy_out:
 	return err;
 }
 
-static bool timer_comp(struct list_head *_a, struct list_head *_b)
+/*
+ * Every CPU keeps the tasks that armed a timer on it in a binary min-heap,
+ * ordered by expiration. Arming and cancelling a timer is O(log n), and every
+ * CPU only services its own expirations.
+ */
+#define TIMER_HEAP_MIN	16
+
+static inline timeu_t timer_expiration(struct task *task)
 {
-	struct task *a = list_entry(_a, struct task, timer_list);
-	struct task *b = list_entry(_b, struct task, timer_list);
+	return task->wfe.timer.expiration;
+}
 
-	return a->wfe.timer.expiration > b->wfe.timer.expiration;
+/* must hold the timer lock in all timer_heap_* routines */
+static void timer_heap_set(struct per_cpu *pcpu, unsigned int idx,
+			   struct task *task)
+{
+	pcpu->timer.heap[idx] = task;
+	task->timer.idx = idx;
 }
 
-void task_sleep_until(struct task *task, struct timespec *ts)
+static void timer_heap_up(struct per_cpu *pcpu, unsigned int idx)
 {
-	time_t wall_ns;
+	struct task *task, *parent;
 
-	spin_lock(&task_lock);
+	task = pcpu->timer.heap[idx];
+	while (idx) {
+		parent = pcpu->timer.heap[(idx - 1) / 2];
+		if (timer_expiration(parent) <= timer_expiration(task))
+			break;
+
+		timer_heap_set(pcpu, idx, parent);
+		idx = (idx - 1) / 2;
+	}
+	timer_heap_set(pcpu, idx, task);
+}
+
+static void timer_heap_down(struct per_cpu *pcpu, unsigned int idx)
+{
+	struct task *task, *child;
+	unsigned int c;
+
+	task = pcpu->timer.heap[idx];
+	while ((c = 2 * idx + 1) < pcpu->timer.nr) {
+		child = pcpu->timer.heap[c];
+		if (c + 1 < pcpu->timer.nr &&
+		    timer_expiration(pcpu->timer.heap[c + 1]) <
+		    timer_expiration(child))
+			child = pcpu->timer.heap[++c];
+
+		if (timer_expiration(task) <= timer_expiration(child))
+			break;
+
+		timer_heap_set(pcpu, idx, child);
+		idx = c;
+	}
+	timer_heap_set(pcpu, idx, task);
+}
+
+/*
+ * Only a CPU itself adds timers to its heap, others only remove them. Hence,
+ * the heap can be grown before taking the lock, so that the allocator never
+ * runs under it.
+ */
+static int timer_heap_reserve(struct per_cpu *pcpu)
+{
+	struct task **heap, **old;
+	unsigned int size;
+
+	if (READ_ONCE(pcpu->timer.nr) < pcpu->timer.size)
+		return 0;
+
+	size = pcpu->timer.size ? 2 * pcpu->timer.size : TIMER_HEAP_MIN;
+	heap = kmalloc(size * sizeof(*heap));
+	if (!heap)
+		return -ENOMEM;
+
+	spin_lock(&pcpu->timer.lock);
+	old = pcpu->timer.heap;
+	if (old)
+		memcpy(heap, old, pcpu->timer.nr * sizeof(*heap));
+	pcpu->timer.heap = heap;
+	pcpu->timer.size = size;
+	spin_unlock(&pcpu->timer.lock);
+
+	kfree(old);
+
+	return 0;
+}
+
+/* Must hold the timer lock, and must have reserved a slot */
+static void timer_heap_add(struct per_cpu *pcpu, struct task *task)
+{
+	if (pcpu->timer.nr == pcpu->timer.size)
+		BUG();
+
+	task->timer.cpu = pcpu->cpuid;
+	timer_heap_set(pcpu, pcpu->timer.nr++, task);
+	timer_heap_up(pcpu, task->timer.idx);
+}
+
+static void timer_heap_del(struct per_cpu *pcpu, struct task *task)
+{
+	struct task *last;
+	unsigned int idx;
+
+	idx = task->timer.idx;
+	task->timer.cpu = TASK_NO_CPU;
+
+	last = pcpu->timer.heap[--pcpu->timer.nr];
+	if (last == task)
+		return;
+
+	timer_heap_set(pcpu, idx, last);
+	timer_heap_up(pcpu, idx);
+	timer_heap_down(pcpu, last->timer.idx);
+}
+
+/* Disarm the task's timer on whatever CPU it was armed */
+static void task_disarm_timer(struct task *task)
+{
+	struct per_cpu *pcpu;
+	unsigned long cpu;
+
+retry:
+	cpu = READ_ONCE(task->timer.cpu);
+	if (cpu == TASK_NO_CPU)
+		return;
+
+	pcpu = per_cpu(cpu);
+	spin_lock(&pcpu->timer.lock);
+	if (task->timer.cpu != cpu) {
+		spin_unlock(&pcpu->timer.lock);
+		goto retry;
+	}
+	timer_heap_del(pcpu, task);
+	spin_unlock(&pcpu->timer.lock);
+}
+
+int task_sleep_until(struct task *task, struct timespec *ts)
+{
+	struct per_cpu *tpcpu;
+	int err;
 
 	if (task->wfe.type != WFE_NONE) {
 		/* A VM may re-arm its timer while a previous one is still pending */
@@ -545,88 +908,97 @@ void task_sleep_until(struct task *task, struct timespec *ts)
 			BUG();
 	}
 
-	wall_ns = ts_to_ns(ts);
-	task->wfe.timer.expiration = wall_ns;
-	task->wfe.type = WFE_TIMER;
+	/* If the timer is already armed, remove it first */
+	task_disarm_timer(task);
+
+	tpcpu = this_per_cpu();
+	err = timer_heap_reserve(tpcpu);
+	if (err) {
+		spin_lock(&task->lock);
+		task->wfe.type = WFE_NONE;
+		spin_unlock(&task->lock);
+		return err;
+	}
+
+	spin_lock(&tpcpu->timer.lock);
+	task->wfe.timer.expiration = ts_to_ns(ts);
+	timer_heap_add(tpcpu, task);
 
+	/* Wakers check the WFE state under the task's lock */
+	spin_lock(&task->lock);
+	task->wfe.type = WFE_TIMER;
 	/* VMs remain runnable */
 	if (task->type == GRINCH_PROCESS)
 		_task_set_wfe(task);
+	spin_unlock(&task->lock);
 
-	/* If the timer is already queued, remove it first */
-	if (!list_empty(&task->timer_list))
-		list_del(&task->timer_list);
-
-	list_add_sorted(&timer_list, &task->timer_list, timer_comp);
-	this_per_cpu()->handle_events = true;
+	tpcpu->handle_events = true;
+	spin_unlock(&tpcpu->timer.lock);
 
-	spin_unlock(&task_lock);
+	return 0;
 }
 
-void task_sleep_for(struct task *task, struct timespec *ts)
+int task_sleep_for(struct task *task, struct timespec *ts)
 {
 	struct timespec now, until;
 
 	timer_get_wall(&now);
 	until = timespec_add(now, *ts);
-	task_sleep_until(task, &until);
+
+	return task_sleep_until(task, &until);
 }
 
 void task_cancel_timer(struct task *task)
 {
-	spin_lock(&task_lock);
-
-	list_del(&task->timer_list);
-	INIT_LIST_HEAD(&task->timer_list);
+	task_disarm_timer(task);
 	if (task->wfe.type == WFE_TIMER)
 		task->wfe.type = WFE_NONE;
-
-	spin_unlock(&task_lock);
 }
 
 void task_handle_events(void)
 {
-	struct task *task, *tmp, *update;
+	struct per_cpu *tpcpu;
+	struct task *task;
+	timeu_t now, next;
 
-	spin_lock(&task_lock);
+	tpcpu = this_per_cpu();
+	now = timer_get_wall_ns();
+	next = -1;
+
+	spin_lock(&tpcpu->timer.lock);
+	while (tpcpu->timer.nr) {
+		task = tpcpu->timer.heap[0];
+		if (timer_expiration(task) > now) {
+			next = timer_expiration(task);
+			break;
+		}
 
-	update = NULL;
-	list_for_each_entry_safe(task, tmp, &timer_list, timer_list) {
 		/* sanity check */
-		if (task->state != TASK_WFE && task->type != GRINCH_VMACHINE)
-			BUG();
-
 		if (task->wfe.type != WFE_TIMER)
 			BUG();
 
-		if (task->wfe.timer.expiration <= timer_get_wall_ns()) {
-			if (task->type == GRINCH_VMACHINE) {
-				vmachine_set_timer_pending(&task->vmachine);
-				if (task->state == TASK_RUNNING) {
-					if (task->on_cpu != this_cpu_id()) {
-						ipi_send(task->on_cpu);
-						continue;
-					}
-				} else {
-					task->state = TASK_RUNNABLE;
-				}
-			} else { /* TASK_PROCESS */
-				task->state = TASK_RUNNABLE;
+		timer_heap_del(tpcpu, task);
+
+		spin_lock(&task->lock);
+		task->wfe.type = WFE_NONE;
+		if (task->type == GRINCH_VMACHINE) {
+			/* The pending timer sticks until the VM is restored */
+			vmachine_set_timer_pending(&task->vmachine);
+			if (task->state == TASK_RUNNING) {
+				if (task->on_cpu != this_cpu_id())
+					ipi_send(task->on_cpu);
+			} else if (task->state == TASK_WFE) {
+				task_wakeup(task);
 			}
-			if (task->state == TASK_WFE)
-				BUG();
-			list_del(&task->timer_list);
-			INIT_LIST_HEAD(&task->timer_list);
-			task->wfe.type = WFE_NONE;
-			continue;
+		} else if (task->state == TASK_WFE) { /* TASK_PROCESS */
+			/* Wait queues might have woken up the task before */
+			task_wakeup(task);
 		}
-
-		update = task;
-		break;
+		spin_unlock(&task->lock);
 	}
 
-	timer_update(update);
-	spin_unlock(&task_lock);
+	timer_update(next);
+	spin_unlock(&tpcpu->timer.lock);
 }
 
 static void do_idle(void)
@@ -718,15 +1090,20 @@ static const char *task_wfe_to_string(enum task_wfe wfe)
 #if 0
 static void dump_timers(void)
 {
+	struct per_cpu *tpcpu;
 	struct task *task;
+	unsigned int i;
 
-	spin_lock(&task_lock);
+	tpcpu = this_per_cpu();
+	spin_lock(&tpcpu->timer.lock);
 
-	list_for_each_entry(task, &timer_list, timer.timer_list)
+	for (i = 0; i < tpcpu->timer.nr; i++) {
+		task = tpcpu->timer.heap[i];
 		pr("PID: %u, Expiration: " PR_TIME_FMT "\n", task->pid,
-		   PR_TIME_PARAMS(task->timer.expiration));
+		   PR_TIME_PARAMS(timer_expiration(task)));
+	}
 
-	spin_unlock(&task_lock);
+	spin_unlock(&tpcpu->timer.lock);
 }
 #endif
 
@@ -775,10 +1152,12 @@ retry:
 			if (tpcpu->idling)
 				BUG();
 		}
+		timer_tick_update();
 		do_idle();
 		goto retry;
 	}
 
+	timer_tick_update();
 	task_restore();
 
 	t = current_task();
@@ -870,3 +1249,85 @@ void process_show_vmas(pid_t pid)
 
 	spin_unlock(&task->lock);
 }
+
+SYSCALL_DEF3(sched_setscheduler, pid_t, pid, int, policy,
+	     const struct sched_param __user *, _param)
+{
+	struct sched_param param;
+	struct task *task;
+	unsigned long cpu;
+	unsigned long ret;
+
+	ret = copy_from_user(current_task(), &param, _param, sizeof(param));
+	if (ret != sizeof(param))
+		return -EFAULT;
+
+	switch (policy) {
+	case SCHED_OTHER:
+		if (param.sched_priority != 0)
+			return -EINVAL;
+		break;
+
+	case SCHED_FIFO:
+		if (param.sched_priority < SCHED_FIFO_PRIO_MIN ||
+		    param.sched_priority > SCHED_FIFO_PRIO_MAX)
+			return -EINVAL;
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	if (pid < 0)
+		return -EINVAL;
+
+	spin_lock(&task_lock);
+	task = pid ? task_by_pid(pid) : current_task();
+	if (!task) {
+		spin_unlock(&task_lock);
+		return -ESRCH;
+	}
+	spin_lock(&task->lock);
+	spin_unlock(&task_lock);
+
+	/* A queued task must be requeued according to its new rank */
+	cpu = rq_remove(task);
+	task->sched.policy = policy;
+	task->sched.prio = param.sched_priority;
+	if (cpu != TASK_NO_CPU) {
+		rq_enqueue(per_cpu(cpu), task);
+		per_cpu(cpu)->schedule = true;
+	} else if (task->state == TASK_RUNNING) {
+		/* Let its CPU reconsider whether it should keep running */
+		cpu = READ_ONCE(task->on_cpu);
+		per_cpu(cpu)->schedule = true;
+		if (cpu != this_cpu_id())
+			ipi_send(cpu);
+	}
+	spin_unlock(&task->lock);
+
+	return 0;
+}
+
+SYSCALL_DEF1(sched_getscheduler, pid_t, pid)
+{
+	struct task *task;
+	int policy;
+
+	if (pid < 0)
+		return -EINVAL;
+
+	spin_lock(&task_lock);
+	task = pid ? task_by_pid(pid) : current_task();
+	if (!task) {
+		spin_unlock(&task_lock);
+		return -ESRCH;
+	}
+	spin_lock(&task->lock);
+	spin_unlock(&task_lock);
+
+	policy = task->sched.policy;
+	spin_unlock(&task->lock);
+
+	return policy;
+}
@@ -22,6 +22,7 @@
 #include <grinch/timer.h>
 
 static unsigned int timer_hz = 50;
+static bool timer_nohz;
 timeu_t wall_base;
 
 static void __init timer_hz_parse(const char *arg)
@@ -38,6 +39,12 @@ static void __init timer_hz_parse(const char *arg)
 }
 bootparam(timer_hz, timer_hz_parse);
 
+static void __init nohz_parse(const char *)
+{
+	timer_nohz = true;
+}
+bootparam(nohz, nohz_parse);
+
 void timer_ticks_to_time(timeu_t ticks, struct timespec *ts)
 {
 	timeu_t ns;
@@ -61,24 +68,57 @@ timeu_t timer_get_wall_ns(void)
 	return arch_timer_get() - wall_base;
 }
 
-void timer_update(struct task *task)
+static void timer_program(struct per_cpu *tpcpu)
 {
-	timeu_t *next;
+	timeu_t next;
 
-	next = &this_per_cpu()->timer.next;
-	if (task && task->wfe.timer.expiration < *next)
-		*next = task->wfe.timer.expiration;
+	next = tpcpu->timer.tick;
+	if (tpcpu->timer.event < next)
+		next = tpcpu->timer.event;
 
-	if (*next != (timeu_t)-1)
-		arch_timer_set(*next + wall_base);
+	if (next != (timeu_t)-1)
+		arch_timer_set(next + wall_base);
 	else
 		arch_timer_set(-1);
 }
 
+void timer_update(timeu_t expiration)
+{
+	struct per_cpu *tpcpu;
+
+	tpcpu = this_per_cpu();
+	tpcpu->timer.event = expiration;
+	timer_program(tpcpu);
+}
+
+/*
+ * In tickless mode, the periodic tick only runs as long as tasks are queued up
+ * behind the current one. Idle CPUs and CPUs that run a single task only wake
+ * up for their next timer expiration.
+ */
+void timer_tick_update(void)
+{
+	struct per_cpu *tpcpu;
+	bool needed;
+
+	if (!timer_nohz || !timer_hz)
+		return;
+
+	tpcpu = this_per_cpu();
+	needed = READ_ONCE(tpcpu->rq.nr_queued) != 0;
+	if (needed == (tpcpu->timer.tick != (timeu_t)-1))
+		return;
+
+	if (needed)
+		tpcpu->timer.tick = timer_get_wall_ns() + HZ_TO_NS(timer_hz);
+	else
+		tpcpu->timer.tick = -1;
+	timer_program(tpcpu);
+}
+
 void handle_timer(void)
 {
 	struct per_cpu *tpcpu;
-	timeu_t next;
 
 	tpcpu = this_per_cpu();
 
@@ -86,24 +126,23 @@ void handle_timer(void)
 	tpcpu->handle_events = true;
 
 	// FIXME: make me cyclic
-	if (timer_hz)
-		next = timer_get_wall_ns() + HZ_TO_NS(timer_hz);
-	else
-		next = -1;
-	tpcpu->timer.next = next;
-	timer_update(NULL);
+	if (tpcpu->timer.tick != (timeu_t)-1)
+		tpcpu->timer.tick = timer_get_wall_ns() + HZ_TO_NS(timer_hz);
+
+	/* task_handle_events() will reprogram the next expiration */
+	timer_update(-1);
 }
 
 static void __init timer_cpu_init(void *)
 {
-	timeu_t *next;
+	struct per_cpu *tpcpu;
 
-	next = &this_per_cpu()->timer.next;
+	tpcpu = this_per_cpu();
 	if (timer_hz)
-		*next = HZ_TO_NS(timer_hz);
+		tpcpu->timer.tick = HZ_TO_NS(timer_hz);
 	else
-		*next = -1;
-	arch_timer_set(*next + wall_base);
+		tpcpu->timer.tick = -1;
+	timer_update(-1);
 	timer_enable();
 }
 
@@ -116,7 +155,8 @@ int __init timer_init(void)
 	if (err)
 		return err;
 
-	pri("Timer Frequency: %uHz\n", timer_hz);
+	pri("Timer Frequency: %uHz%s\n", timer_hz,
+	    timer_nohz ? " (tickless)" : "");
 	wall_base = arch_timer_get();
 
 	ns_to_ts(wall_base, &ts);
@@ -24,16 +24,12 @@
 #include <grinch/task.h>
 #include <grinch/uaccess.h>
 
-/* Let's keep the zero page here, until we need to share it */
-static const unsigned long
-zero_page[PAGE_SIZE / sizeof(unsigned long)] __aligned(PAGE_SIZE);
-
 bool is_urange(const void *_base, size_t size)
 {
 	uintptr_t base = (uintptr_t)_base;
 
 	if (base >= USER_START && base < USER_END &&
-	    (base + size) <= USER_END)
+	    size <= USER_END - base)
 		return true;
 
 	return false;
@@ -50,62 +46,113 @@ void *user_to_direct(struct mm *mm, const void __user *s)
 	return p2v(pa);
 }
 
-static void *user_to_direct_fault(struct task *t, void __user *s)
+/*
+ * Direct map address of a physically contiguous run. Runs may cross memory
+ * areas, which aren't necessarily adjacent in the direct map. Cut them at the
+ * page boundary in that case.
+ */
+static void *direct_run(paddr_t pa, size_t *len)
 {
-	void *ret;
+	void *direct;
+
+	direct = p2v(pa);
+	if (*len > page_bytes_left(direct) &&
+	    p2v(pa + *len - 1) != direct + *len - 1)
+		*len = page_bytes_left(direct);
+
+	return direct;
+}
+
+/*
+ * This routine is meant for writing to user pages. Translates as much of
+ * [s, s + n) as possible in one go, len receives the length of the run.
+ */
+static void *
+user_to_direct_fault(struct task *t, void __user *s, size_t n, size_t *len)
+{
+	page_table_t pt = t->process.mm.page_table;
+	size_t off;
+	paddr_t pa;
 	int err;
 
-	ret = user_to_direct(&t->process.mm, s);
-	if (!ret) {
+	/*
+	 * Fault in missing pages, and unshare copy-on-write pages before the
+	 * kernel writes to them behind the MMU's back.
+	 */
+	pa = paging_get_phys_run(pt, s, n, len);
+	if (pa == INVALID_PHYS_ADDR || phys_page_shared(pa & PAGE_MASK)) {
 		err = process_handle_fault(t, s, true);
 		if (err)
 			return NULL;
 
-		ret = user_to_direct(&t->process.mm, s);
+		pa = paging_get_phys_run(pt, s, n, len);
+		if (pa == INVALID_PHYS_ADDR)
+			return NULL;
 	}
 
-	return ret;
+	/* The run ends before the next page that still is copy-on-write */
+	for (off = page_bytes_left(s); off < *len; off += PAGE_SIZE)
+		if (phys_page_shared(pa + off)) {
+			*len = off;
+			break;
+		}
+
+	return direct_run(pa, len);
 }
 
 /* This routine is only meant for reading from user pages! */
-static const void *user_to_direct_null(struct task *t, const void __user *s)
+static const void *
+user_to_direct_null(struct task *t, const void __user *s, size_t n, size_t *len)
 {
+	page_table_t pt = t->process.mm.page_table;
 	struct vma *vma;
-	void *ret;
+	paddr_t pa;
+	int err;
+
+	pa = paging_get_phys_run(pt, s, n, len);
+	if (pa != INVALID_PHYS_ADDR)
+		return direct_run(pa, len);
 
-	ret = user_to_direct(&t->process.mm, s);
 	/* If we have a lazy VMA, redirect to the null page. */
-	if (!ret) {
-		vma = uvma_at(&t->process, s);
-		/* No VMA behind from? We're out. */
-		if (!vma)
+	vma = uvma_at(&t->process, s);
+	/* No VMA behind from? We're out. */
+	if (!vma)
+		return NULL;
+
+	/* A non-lazy VMA must not fault */
+	if (!(vma->flags & VMA_FLAG_LAZY))
+		BUG();
+
+	/* File-backed pages must be faulted in */
+	if (s < vma->base + vma->file.size) {
+		err = process_handle_fault(t, (void __user *)s, false);
+		if (err)
 			return NULL;
 
-		/* A non-lazy VMA must not fault */
-		if (!(vma->flags & VMA_FLAG_LAZY))
-			BUG();
+		pa = paging_get_phys_run(pt, s, n, len);
+		if (pa == INVALID_PHYS_ADDR)
+			return NULL;
 
-		ret = (void *)zero_page + page_voffset(s);
+		return direct_run(pa, len);
 	}
 
-	return ret;
+	*len = min(n, (size_t)page_bytes_left(s));
+
+	return p2v(zero_page) + page_voffset(s);
 }
 
 unsigned long umemset(struct task *t, void *dst, int c, size_t n)
 {
-	unsigned int remaining;
 	unsigned long ret;
 	size_t written;
 	void *direct;
 
 	ret = 0;
 	while (n) {
-		direct = user_to_direct_fault(t, dst);
+		direct = user_to_direct_fault(t, dst, n, &written);
 		if (!direct)
 			break;
 
-		remaining = page_bytes_left(direct);
-		written = min(n, remaining);
 		memset(direct, c, written);
 
 		ret += written;
@@ -119,19 +166,16 @@ unsigned long umemset(struct task *t, void *dst, int c, size_t n)
 unsigned long copy_from_user(struct task *t, void *to, const void *from,
 			     unsigned long n)
 {
-	unsigned int remaining;
 	const void *direct;
 	unsigned long sum;
 	size_t written;
 
 	sum = 0;
 	while (n) {
-		direct = user_to_direct_null(t, from);
+		direct = user_to_direct_null(t, from, n, &written);
 		if (!direct)
 			break;
 
-		remaining = page_bytes_left(direct);
-		written = min(n, remaining);
 		memcpy(to, direct, written);
 
 		n -= written;
@@ -145,19 +189,16 @@ unsigned long copy_from_user(struct task *t, void *to, const void *from,
 
 unsigned long copy_to_user(struct task *t, void *d, const void *s, size_t n)
 {
-	unsigned int remaining;
 	unsigned long copied;
 	size_t written;
 	void *direct;
 
 	copied = 0;
 	while (n) {
-		direct = user_to_direct_fault(t, d);
+		direct = user_to_direct_fault(t, d, n, &written);
 		if (!direct)
 			return copied;
 
-		remaining = page_bytes_left(direct);
-		written = min(remaining, n);
 		memcpy(direct, s, written);
 
 		n -= written;
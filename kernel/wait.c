@@ -0,0 +1,219 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#define dbg_fmt(x)	"wait: " x
+
+#include <grinch/alloc.h>
+#include <grinch/errno.h>
+#include <grinch/percpu.h>
+#include <grinch/syscall.h>
+#include <grinch/task.h>
+#include <grinch/time.h>
+#include <grinch/wait.h>
+
+int wait_prepare(struct task *task, unsigned int n)
+{
+	struct waiter *pool;
+
+	if (task->wait.nr)
+		BUG();
+
+	/* Most syscalls wait for a single object */
+	if (n <= 1) {
+		task->wait.waiters = &task->wait.single;
+	} else {
+		if (n > task->wait.pool_size) {
+			pool = kmalloc(n * sizeof(*pool));
+			if (!pool)
+				return -ENOMEM;
+
+			kfree(task->wait.pool);
+			task->wait.pool = pool;
+			task->wait.pool_size = n;
+		}
+		task->wait.waiters = task->wait.pool;
+	}
+	task->wait.max = n;
+
+	return 0;
+}
+
+static void
+_wait_register(struct task *task, struct wait_queue *wq, bool exclusive)
+{
+	struct waiter *w;
+
+	if (task->wait.nr >= task->wait.max)
+		BUG();
+
+	w = &task->wait.waiters[task->wait.nr++];
+	w->task = task;
+	w->wq = wq;
+	w->woken = false;
+	w->exclusive = exclusive;
+
+	spin_lock(&wq->lock);
+	list_add_tail(&w->entry, &wq->waiters);
+	spin_unlock(&wq->lock);
+}
+
+void wait_register(struct task *task, struct wait_queue *wq)
+{
+	_wait_register(task, wq, false);
+}
+
+void wait_register_exclusive(struct task *task, struct wait_queue *wq)
+{
+	_wait_register(task, wq, true);
+}
+
+/* must hold the task's lock */
+static void wait_wake_task(struct task *task)
+{
+	if (task->state != TASK_WFE)
+		return;
+
+	/* The timer of a deadline stays armed until the restart cancels it */
+	if (task->wfe.type == WFE_WAIT)
+		task->wfe.type = WFE_NONE;
+	task_wakeup(task);
+}
+
+int wait_sleep(struct task *task, timeu_t deadline)
+{
+	struct timespec until;
+	unsigned int i;
+	int err;
+
+	task->wait.blocked = true;
+	if (deadline) {
+		ns_to_ts(deadline, &until);
+		err = task_sleep_until(task, &until);
+		if (err)
+			return err;
+		spin_lock(&task->lock);
+	} else {
+		spin_lock(&task->lock);
+		task->wfe.type = WFE_WAIT;
+		task_set_wfe(task);
+	}
+	this_per_cpu()->schedule = true;
+
+	/* An event might have arrived before the task went to sleep */
+	for (i = 0; i < task->wait.nr; i++)
+		if (task->wait.waiters[i].woken) {
+			wait_wake_task(task);
+			break;
+		}
+	spin_unlock(&task->lock);
+
+	return -ERESTARTSYS;
+}
+
+/*
+ * An exclusive waiter that was woken up, but will never restart its syscall,
+ * passes the wakeup on. Otherwise, the event would be lost for the remaining
+ * waiters.
+ */
+static void __wait_finish(struct task *task, bool pass_on)
+{
+	struct waiter *w;
+	unsigned int i;
+	bool woken;
+
+	for (i = 0; i < task->wait.nr; i++) {
+		w = &task->wait.waiters[i];
+		spin_lock(&w->wq->lock);
+		/* Wakers already dequeued the waiter */
+		if (!list_empty(&w->entry))
+			list_del(&w->entry);
+		woken = w->woken;
+		spin_unlock(&w->wq->lock);
+
+		if (pass_on && woken && w->exclusive)
+			wake_up(w->wq);
+	}
+	task->wait.nr = 0;
+	task->wait.max = 0;
+
+	if (task->wait.blocked) {
+		task->wait.blocked = false;
+		task_cancel_timer(task);
+	}
+}
+
+void wait_finish(struct task *task)
+{
+	__wait_finish(task, false);
+}
+
+void wait_destroy(struct task *task)
+{
+	__wait_finish(task, true);
+
+	kfree(task->wait.pool);
+	task->wait.pool = NULL;
+	task->wait.pool_size = 0;
+}
+
+/* must hold the wait queue's lock */
+static void wake_waiter(struct waiter *w)
+{
+	struct task *task;
+
+	list_del_init(&w->entry);
+
+	task = w->task;
+	spin_lock(&task->lock);
+	w->woken = true;
+	wait_wake_task(task);
+	spin_unlock(&task->lock);
+}
+
+/*
+ * Woken waiters are dequeued. Until the woken tasks restart their syscalls
+ * and enqueue themselves again, further events find an empty queue, so
+ * bursts of events only cause a single wakeup.
+ */
+static unsigned int __wake_up(struct wait_queue *wq, bool all)
+{
+	struct waiter *w, *tmp;
+	bool exclusive_woken;
+	unsigned int woken;
+
+	woken = 0;
+	exclusive_woken = false;
+	spin_lock(&wq->lock);
+	list_for_each_entry_safe(w, tmp, &wq->waiters, entry) {
+		if (w->exclusive && !all) {
+			/* Only wake up the first exclusive waiter */
+			if (exclusive_woken)
+				continue;
+			exclusive_woken = true;
+		}
+		wake_waiter(w);
+		woken++;
+	}
+	spin_unlock(&wq->lock);
+
+	return woken;
+}
+
+unsigned int wake_up(struct wait_queue *wq)
+{
+	return __wake_up(wq, false);
+}
+
+unsigned int wake_up_all(struct wait_queue *wq)
+{
+	return __wake_up(wq, true);
+}
@@ -73,14 +73,12 @@ static unsigned long _find_next_bit(const unsigned long *addr1,
 	return min(start + __ffsl(tmp), nbits);
 }
 
-static inline
 unsigned long find_next_bit(const unsigned long *addr, unsigned long size,
 			    unsigned long offset)
 {
 	return _find_next_bit(addr, NULL, size, offset, 0UL, 0);
 }
 
-static inline
 unsigned long find_next_zero_bit(const unsigned long *addr, unsigned long size,
 				 unsigned long offset)
 {
@@ -7,6 +7,7 @@ LIB_OBJS += hexdump.o
 LIB_OBJS += libgcc.o
 LIB_OBJS += panic.o
 LIB_OBJS += printk.o
+LIB_OBJS += rbtree.o
 LIB_OBJS += refcount.o
 LIB_OBJS += ringbuf.o
 LIB_OBJS += string.o
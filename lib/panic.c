@@ -33,6 +33,11 @@ static void __noreturn panic_stop(void)
 	cpu_halt();
 }
 
+bool in_panic(void)
+{
+	return is_panic;
+}
+
 void check_panic(void)
 {
 	if (is_panic)
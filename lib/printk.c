@@ -12,6 +12,8 @@
 
 #include <ctype.h>
 
+#include <asm/spinlock.h>
+
 #include <grinch/boot.h>
 #include <grinch/cpu.h>
 #include <grinch/bootparam.h>
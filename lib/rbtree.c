@@ -0,0 +1,225 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <grinch/rbtree.h>
+
+/* Missing leaves count as black */
+static inline bool is_red(const struct rb_node *node)
+{
+	return node && node->red;
+}
+
+static void rb_replace_child(struct rb_root *root, struct rb_node *parent,
+			     struct rb_node *old, struct rb_node *new)
+{
+	if (!parent)
+		root->node = new;
+	else if (parent->left == old)
+		parent->left = new;
+	else
+		parent->right = new;
+}
+
+static void rb_rotate_left(struct rb_root *root, struct rb_node *node)
+{
+	struct rb_node *right = node->right;
+
+	node->right = right->left;
+	if (right->left)
+		right->left->parent = node;
+
+	right->parent = node->parent;
+	rb_replace_child(root, node->parent, node, right);
+
+	right->left = node;
+	node->parent = right;
+}
+
+static void rb_rotate_right(struct rb_root *root, struct rb_node *node)
+{
+	struct rb_node *left = node->left;
+
+	node->left = left->right;
+	if (left->right)
+		left->right->parent = node;
+
+	left->parent = node->parent;
+	rb_replace_child(root, node->parent, node, left);
+
+	left->right = node;
+	node->parent = left;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *parent, *gparent, *uncle;
+
+	while ((parent = node->parent) && parent->red) {
+		/* The parent is red, so it isn't the root */
+		gparent = parent->parent;
+
+		if (parent == gparent->left) {
+			uncle = gparent->right;
+			if (is_red(uncle)) {
+				parent->red = uncle->red = false;
+				gparent->red = true;
+				node = gparent;
+				continue;
+			}
+
+			if (node == parent->right) {
+				rb_rotate_left(root, parent);
+				parent = node;
+			}
+
+			parent->red = false;
+			gparent->red = true;
+			rb_rotate_right(root, gparent);
+			break;
+		} else {
+			uncle = gparent->left;
+			if (is_red(uncle)) {
+				parent->red = uncle->red = false;
+				gparent->red = true;
+				node = gparent;
+				continue;
+			}
+
+			if (node == parent->left) {
+				rb_rotate_right(root, parent);
+				parent = node;
+			}
+
+			parent->red = false;
+			gparent->red = true;
+			rb_rotate_left(root, gparent);
+			break;
+		}
+	}
+
+	root->node->red = false;
+}
+
+/*
+ * A black node was removed above node, which may be a missing leaf. Hence,
+ * its parent is passed along.
+ */
+static void rb_erase_color(struct rb_root *root, struct rb_node *node,
+			   struct rb_node *parent)
+{
+	struct rb_node *sibling;
+
+	while (node != root->node && !is_red(node)) {
+		if (node == parent->left) {
+			sibling = parent->right;
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rb_rotate_left(root, parent);
+				sibling = parent->right;
+			}
+
+			if (!is_red(sibling->left) && !is_red(sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			if (!is_red(sibling->right)) {
+				sibling->left->red = false;
+				sibling->red = true;
+				rb_rotate_right(root, sibling);
+				sibling = parent->right;
+			}
+
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->right->red = false;
+			rb_rotate_left(root, parent);
+		} else {
+			sibling = parent->left;
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rb_rotate_right(root, parent);
+				sibling = parent->left;
+			}
+
+			if (!is_red(sibling->left) && !is_red(sibling->right)) {
+				sibling->red = true;
+				node = parent;
+				parent = node->parent;
+				continue;
+			}
+
+			if (!is_red(sibling->left)) {
+				sibling->right->red = false;
+				sibling->red = true;
+				rb_rotate_left(root, sibling);
+				sibling = parent->left;
+			}
+
+			sibling->red = parent->red;
+			parent->red = false;
+			sibling->left->red = false;
+			rb_rotate_right(root, parent);
+		}
+		node = root->node;
+	}
+
+	if (node)
+		node->red = false;
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *child, *parent, *next;
+	bool red;
+
+	if (node->left && node->right) {
+		/* Replace the node by its successor, which has no left child */
+		next = node->right;
+		while (next->left)
+			next = next->left;
+
+		child = next->right;
+		red = next->red;
+		if (next->parent == node) {
+			parent = next;
+		} else {
+			parent = next->parent;
+			parent->left = child;
+			if (child)
+				child->parent = parent;
+
+			next->right = node->right;
+			node->right->parent = next;
+		}
+
+		next->left = node->left;
+		node->left->parent = next;
+		next->parent = node->parent;
+		next->red = node->red;
+		rb_replace_child(root, node->parent, node, next);
+	} else {
+		child = node->left ? node->left : node->right;
+		parent = node->parent;
+		red = node->red;
+		if (child)
+			child->parent = parent;
+		rb_replace_child(root, parent, node, child);
+	}
+
+	if (!red)
+		rb_erase_color(root, child, parent);
+}
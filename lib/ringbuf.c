@@ -69,3 +69,20 @@ char *ringbuf_read(struct ringbuf *rb, unsigned int *sz)
 
 	return &rb->buf[pos];
 }
+
+char *ringbuf_reserve(struct ringbuf *rb, unsigned int *sz)
+{
+	unsigned int pos;
+	unsigned int space;
+
+	space = ringbuf_space(rb);
+	if (space == 0) {
+		*sz = 0;
+		return NULL;
+	}
+
+	pos = rb->tail % rb->size;
+	*sz = min(space, rb->size - pos);
+
+	return &rb->buf[pos];
+}
@@ -10,6 +10,8 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <asm-generic/paging.h>
+
 #include <grinch/string.h>
 #include <grinch/alloc.h>
 
@@ -18,3 +20,40 @@
 #define ALLOCATOR	kmalloc
 
 #include "../common/src/string.c"
+
+/*
+ * Pages are aligned and their size is a multiple of eight words, so neither
+ * heads nor tails need to be handled.
+ */
+void clear_page(void *page)
+{
+	unsigned long *w, *end;
+
+	for (w = page, end = page + PAGE_SIZE; w < end; w += 8) {
+		w[0] = 0;
+		w[1] = 0;
+		w[2] = 0;
+		w[3] = 0;
+		w[4] = 0;
+		w[5] = 0;
+		w[6] = 0;
+		w[7] = 0;
+	}
+}
+
+void copy_page(void *dst, const void *src)
+{
+	const unsigned long *s = src;
+	unsigned long *d, *end;
+
+	for (d = dst, end = dst + PAGE_SIZE; d < end; d += 8, s += 8) {
+		d[0] = s[0];
+		d[1] = s[1];
+		d[2] = s[2];
+		d[3] = s[3];
+		d[4] = s[4];
+		d[5] = s[5];
+		d[6] = s[6];
+		d[7] = s[7];
+	}
+}
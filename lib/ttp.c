@@ -18,6 +18,8 @@
 #include <grinch/timer.h>
 #include <grinch/gcall.h>
 #include <grinch/bootparam.h>
+#include <grinch/percpu.h>
+#include <grinch/printk.h>
 
 struct ttp_event {
 	unsigned int id;
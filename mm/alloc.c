@@ -18,11 +18,17 @@
 #include <grinch/alloc.h>
 #include <grinch/bootparam.h>
 #include <grinch/errno.h>
+#include <grinch/minmax.h>
 #include <grinch/panic.h>
+#include <grinch/paging.h>
 #include <grinch/printk.h>
 #include <grinch/salloc.h>
+#include <grinch/slab.h>
 #include <grinch/vma.h>
 
+/* Every growth flushes the TLBs of all CPUs, so don't grow in tiny steps */
+#define KHEAP_GROW_MIN	(256 * KIB)
+
 static DEFINE_SPINLOCK(alloc_lock);
 
 static struct vma vma_kheap = {
@@ -55,7 +61,8 @@ static void __init kheap_size_parse(const char *arg)
 		return;
 	}
 
-	if (sz > 1 * GIB) {
+	sz = page_up(sz);
+	if (sz > KHEAP_SIZE) {
 		pri("Warning: kheap_size too big\n");
 		return;
 	}
@@ -90,10 +97,39 @@ void kheap_stats(void)
 
 	if (err)
 		panic("salloc_stats: %s\n", salloc_err_str(err));
+
+	kmem_caches_dump();
+}
+
+/*
+ * The kernel heap starts with kheap_size bytes, and grows on demand within
+ * its window. Must hold alloc_lock.
+ */
+static int kheap_grow(size_t increase)
+{
+	size_t avail;
+	int err;
+
+	avail = KHEAP_SIZE - vma_kheap.size;
+	increase = page_up(increase);
+	if (increase > avail)
+		return -ENOMEM;
+
+	increase = min(max(increase, (size_t)KHEAP_GROW_MIN), avail);
+	err = kvma_grow(&vma_kheap, increase);
+	if (err)
+		return err;
+
+	err = salloc_increase(vma_kheap.base, increase);
+	if (err)
+		panic("salloc_increase failed: %s\n", salloc_err_str(err));
+
+	return 0;
 }
 
 void *kmalloc(size_t size)
 {
+	size_t increase;
 	void *ret;
 	int err;
 
@@ -104,7 +140,11 @@ void *kmalloc(size_t size)
 	}
 
 	spin_lock(&alloc_lock);
-	err = salloc_alloc(vma_kheap.base, size, &ret, NULL);
+	do {
+		err = salloc_alloc(vma_kheap.base, size, &ret, &increase);
+		if (err != -ENOMEM || kheap_grow(increase))
+			break;
+	} while (true);
 	spin_unlock(&alloc_lock);
 
 	if (err == -ENOMEM)
@@ -145,8 +185,17 @@ int __init kheap_init(void)
 {
 	int err;
 
-	pri("Kernel Heap base: %p, size: 0x%lx\n",
-	    vma_kheap.base, vma_kheap.size);
+	pri("Kernel Heap base: %p, size: 0x%lx, max: 0x%lx\n",
+	    vma_kheap.base, vma_kheap.size, KHEAP_SIZE);
+
+	/*
+	 * Process page tables only receive a copy of the kernel's root
+	 * entries. Populate the root slots of the whole window, as the heap
+	 * grows at runtime.
+	 */
+	err = paging_prealloc(kernel_root, vma_kheap.base, KHEAP_SIZE);
+	if (err)
+		return err;
 
 	err = kvma_create(&vma_kheap);
 	if (err)
@@ -20,16 +20,27 @@
 #include <grinch/errno.h>
 #include <grinch/init.h>
 #include <grinch/paging.h>
+#include <grinch/percpu.h>
 #include <grinch/printk.h>
+#include <grinch/vma.h>
 
 /*
  * ASIDs come from a global bitmap sized by the number of ASIDs the
- * architecture provides. ASID 0 is reserved as the untagged fallback
- * and never handed out.
+ * architecture provides. ASID 0 is reserved for the kernel and for
+ * hardware without ASIDs, and never handed out.
+ *
+ * An address space's ASID is only valid within the generation it was
+ * handed out in. Once the bitmap runs dry, the generation is bumped, the
+ * bitmap starts over, and every CPU flushes its TLB once before it
+ * activates the next address space. Address spaces of older generations
+ * lazily pick a fresh ASID when they are activated the next time.
  */
 static DEFINE_SPINLOCK(asid_lock);
 static unsigned long *asid_bitmap;
 static unsigned long nr_asids;
+static unsigned long asid_generation = 1;
+/* CPUs that must flush their TLB before activating an address space */
+static DECLARE_BITMAP(asid_flush_pending, MAX_CPUS);
 
 int __init asid_init(void)
 {
@@ -50,41 +61,69 @@ int __init asid_init(void)
 	return 0;
 }
 
-unsigned long asid_alloc(void)
+/* must hold asid_lock */
+static unsigned long __asid_rollover(void)
 {
+	asid_generation++;
+	bitmap_clear(asid_bitmap, 1, nr_asids - 1);
+
+	/*
+	 * Translations of older generations may linger anywhere. CPUs that
+	 * currently run such an address space may continue to do so: no
+	 * other CPU's TLB is affected, and no CPU activates an ASID of the
+	 * new generation before it is clean.
+	 */
+	bitmap_set(asid_flush_pending, 0, MAX_CPUS);
+
+	return 1;
+}
+
+bool asid_activate(struct mm *mm)
+{
+	unsigned int cpu = this_cpu_id();
 	unsigned long asid;
+	bool flush;
 
-	/* No bitmap: only the untagged ASID 0 is available. */
+	/* Untagged address spaces can not be kept apart */
 	if (!asid_bitmap)
-		return 0;
+		return true;
 
 	spin_lock(&asid_lock);
-	asid = bitmap_find_next_zero_area(asid_bitmap, nr_asids, 0, 1, 0);
-	if (asid >= nr_asids) {
-		asid = 0;
-		goto unlock_out;
+	if (mm->asid_gen != asid_generation) {
+		asid = find_next_zero_bit(asid_bitmap, nr_asids, 1);
+		if (asid >= nr_asids)
+			asid = __asid_rollover();
+		bitmap_set(asid_bitmap, asid, 1);
+
+		mm->asid = asid;
+		mm->asid_gen = asid_generation;
+		/* Nothing is tagged with the new ASID yet */
+		bitmap_clear(mm->cpus, 0, MAX_CPUS);
 	}
-	bitmap_set(asid_bitmap, asid, 1);
 
-unlock_out:
+	flush = test_bit(cpu, asid_flush_pending);
+	if (flush)
+		__clear_bit(cpu, asid_flush_pending);
 	spin_unlock(&asid_lock);
 
-	return asid;
+	return flush;
 }
 
-void asid_free(unsigned long asid)
+void asid_free(struct mm *mm)
 {
-	if (!asid)
+	if (!mm->asid)
 		return;
 
 	/*
-	 * Scrub every CPU before the ASID becomes available again: address
-	 * space switches no longer flush, so a reused ASID must not inherit
-	 * its predecessor's translations.
+	 * Scrub every CPU that ran the address space before the ASID becomes
+	 * available again: address space switches no longer flush, so a
+	 * reused ASID must not inherit its predecessor's translations.
 	 */
-	flush_tlb_asid(asid);
+	flush_tlb_asid(mm->cpus, mm->asid);
 
+	/* ASIDs of older generations were already recycled by the rollover */
 	spin_lock(&asid_lock);
-	bitmap_clear(asid_bitmap, asid, 1);
+	if (mm->asid_gen == asid_generation)
+		bitmap_clear(asid_bitmap, mm->asid, 1);
 	spin_unlock(&asid_lock);
 }
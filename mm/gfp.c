@@ -14,9 +14,11 @@
 
 #include <asm/spinlock.h>
 
+#include <grinch/atomic.h>
 #include <grinch/bitmap.h>
 #include <grinch/fdt.h>
 #include <grinch/gfp.h>
+#include <grinch/minmax.h>
 #include <grinch/mm.h>
 #include <grinch/paging.h>
 #include <grinch/percpu.h>
@@ -28,14 +30,31 @@
 #define KMM_PAGES	PAGES(GRINCH_SIZE)
 #define KMM_SIZE	(KMM_PAGES * PAGE_SIZE)
 
-#if KMM_PAGES % 64 != 0
-#error GRINCH_SIZE must fit into internal bitmap without remainder
-#endif
+/* Upper bound of words for the per-order bitmaps of an area */
+#define BUDDY_WORDS(pages)	(BITS_TO_LONGS(2 * (pages)) + GFP_MAX_ORDER + 1)
 
 static DEFINE_SPINLOCK(gfp_lock);
 
+/*
+ * Every memory area is managed by a binary buddy allocator. Free blocks of
+ * 1 << order pages are tracked per order in a bitmap, where bit i stands for
+ * the block that starts at page i << order. The bitmaps live out of band:
+ * free pages are never touched, as they might still hold firmware, the
+ * device-tree or the initrd until they are reserved.
+ */
+struct buddy_order {
+	unsigned long *bitmap;
+	unsigned long blocks;
+	unsigned long nr_free;
+	/* There's no free block below this index */
+	unsigned long hint;
+};
+
 struct memory_area {
-	struct bitmap bitmap;
+	struct buddy_order orders[GFP_MAX_ORDER + 1];
+	unsigned long pages;
+	/* Number of additional owners per page, see phys_page_get() */
+	atomic_t *refs;
 	struct {
 		paddr_t base;
 		paddr_t end;
@@ -47,19 +66,17 @@ struct memory_area {
 	bool valid;
 };
 
+static unsigned long kmm_buddy_bitmap[BUDDY_WORDS(KMM_PAGES)];
+
 /*
  * For the moment, we have two areas:
  *   0: Kernel Memory area. Here lives grinch and some free pages.
  *   1: Physical Memory. Here lives the whole physical memory. The whole
  *      grinch/KMM area is marked as used here.
  */
-static struct memory_area memory_areas[2] =
+static struct memory_area memory_areas[GFP_MEMORY_AREAS] =
 {
 	[0] = {
-		.bitmap = {
-			.bitmap = (unsigned long[BITS_TO_LONGS(KMM_PAGES)]){},
-			.bit_max = KMM_PAGES,
-		},
 		.p = {}, // filled during initialisation
 		.v = {
 			.base = (void *)GRINCH_BASE,
@@ -139,31 +156,316 @@ static struct memory_area *find_area(const void *virt)
 	return NULL;
 }
 
+static inline struct gfp_pcp *area_pcp(struct memory_area *area)
+{
+	return &this_per_cpu()->gfp_pcp[area - memory_areas];
+}
+
+/* The smallest order whose blocks hold at least the given number of pages */
+static unsigned int pages_to_order(unsigned long pages)
+{
+	unsigned int order;
+
+	for (order = 0; (1UL << order) < pages; order++);
+
+	return order;
+}
+
+/* Hand out the per-order bitmaps from words, which holds BUDDY_WORDS(pages) */
+static void buddy_init(struct memory_area *area, unsigned long *words,
+		       unsigned long pages)
+{
+	struct buddy_order *bo;
+	unsigned int order;
+
+	area->pages = pages;
+	for (order = 0; order <= GFP_MAX_ORDER; order++) {
+		bo = &area->orders[order];
+		bo->bitmap = words;
+		bo->blocks = pages >> order;
+		bo->nr_free = 0;
+		bo->hint = 0;
+		words += BITS_TO_LONGS(bo->blocks);
+	}
+}
+
+/* must hold the gfp_lock in all __buddy_* routines */
+static inline bool __buddy_test(struct memory_area *area, unsigned int order,
+				unsigned long idx)
+{
+	struct buddy_order *bo = &area->orders[order];
+
+	return idx < bo->blocks && test_bit(idx, bo->bitmap);
+}
+
+static inline void __buddy_set(struct memory_area *area, unsigned int order,
+			       unsigned long idx)
+{
+	struct buddy_order *bo = &area->orders[order];
+
+	__set_bit(idx, bo->bitmap);
+	bo->nr_free++;
+	if (idx < bo->hint)
+		bo->hint = idx;
+}
+
+static inline void __buddy_clear(struct memory_area *area, unsigned int order,
+				 unsigned long idx)
+{
+	struct buddy_order *bo = &area->orders[order];
+
+	__clear_bit(idx, bo->bitmap);
+	bo->nr_free--;
+}
+
+/* Free the naturally aligned block at page, and merge it with its buddies */
+static void __buddy_free(struct memory_area *area, unsigned long page,
+			 unsigned int order)
+{
+	unsigned long idx;
+
+	idx = page >> order;
+	while (order < GFP_MAX_ORDER && __buddy_test(area, order, idx ^ 1)) {
+		__buddy_clear(area, order, idx ^ 1);
+		idx >>= 1;
+		order++;
+	}
+	__buddy_set(area, order, idx);
+}
+
+/* Free an arbitrary range of pages as the largest possible aligned blocks */
+static void __buddy_free_range(struct memory_area *area, unsigned long page,
+			       unsigned long pages)
+{
+	unsigned int order;
+
+	while (pages) {
+		order = page ? __ffsl(page) : GFP_MAX_ORDER;
+		if (order > GFP_MAX_ORDER)
+			order = GFP_MAX_ORDER;
+		while ((1UL << order) > pages)
+			order--;
+
+		__buddy_free(area, page, order);
+		page += 1UL << order;
+		pages -= 1UL << order;
+	}
+}
+
+/* Take the smallest free block of at least order, and split it down */
+static long __buddy_alloc(struct memory_area *area, unsigned int order)
+{
+	struct buddy_order *bo;
+	unsigned int o;
+	unsigned long idx;
+
+	for (o = order; o <= GFP_MAX_ORDER; o++) {
+		bo = &area->orders[o];
+		if (bo->nr_free)
+			goto found;
+	}
+
+	return -ENOMEM;
+
+found:
+	idx = find_next_bit(bo->bitmap, bo->blocks, bo->hint);
+	if (idx >= bo->blocks)
+		panic("gfp: corrupt free bitmap of order %u\n", o);
+	bo->hint = idx;
+	__buddy_clear(area, o, idx);
+
+	/* Return the upper halves */
+	while (o > order) {
+		o--;
+		idx <<= 1;
+		__buddy_set(area, o, idx + 1);
+	}
+
+	return idx << order;
+}
+
+/*
+ * Find the free block that contains the aligned block at page of the given
+ * order. As buddies are always merged, a completely free aligned block is
+ * always part of one single free block.
+ */
+static int __buddy_find(struct memory_area *area, unsigned long page,
+			unsigned int order)
+{
+	for (; order <= GFP_MAX_ORDER; order++)
+		if (__buddy_test(area, order, page >> order))
+			return order;
+
+	return -ENOMEM;
+}
+
+/* Allocate the aligned block at page out of the free block of order found */
+static void __buddy_carve(struct memory_area *area, unsigned long page,
+			  unsigned int order, unsigned int found)
+{
+	unsigned long idx;
+
+	__buddy_clear(area, found, page >> found);
+	while (found > order) {
+		found--;
+		idx = page >> found;
+		__buddy_set(area, found, idx ^ 1);
+	}
+}
+
+/* Reserve a specific range of pages. Either all of them, or none. */
+static int __buddy_reserve(struct memory_area *area, unsigned long page,
+			   unsigned long pages)
+{
+	unsigned long p, left;
+	unsigned int order;
+	int found;
+	bool check;
+
+	if (page + pages > area->pages)
+		return -ERANGE;
+
+	/* The first pass only checks, the second one allocates */
+	for (check = true; ; check = false) {
+		for (p = page, left = pages; left; p += 1UL << order,
+		     left -= 1UL << order) {
+			order = p ? __ffsl(p) : GFP_MAX_ORDER;
+			if (order > GFP_MAX_ORDER)
+				order = GFP_MAX_ORDER;
+			while ((1UL << order) > left)
+				order--;
+
+			found = __buddy_find(area, p, order);
+			if (found < 0)
+				return found;
+
+			if (!check)
+				__buddy_carve(area, p, order, found);
+		}
+
+		if (!check)
+			return 0;
+	}
+}
+
+/* Give back the cached pages of this CPU */
+static void pcp_drain(struct memory_area *area, unsigned int keep)
+{
+	struct gfp_pcp *pcp = area_pcp(area);
+
+	spin_lock(&gfp_lock);
+	while (pcp->nr > keep)
+		__buddy_free(area, pcp->pages[--pcp->nr], 0);
+	spin_unlock(&gfp_lock);
+}
+
+/* Order-0 allocations are served from a per-CPU cache without locking */
+static long pcp_alloc(struct memory_area *area)
+{
+	struct gfp_pcp *pcp = area_pcp(area);
+	unsigned int i;
+	long page;
+
+	if (pcp->nr)
+		return pcp->pages[--pcp->nr];
+
+	spin_lock(&gfp_lock);
+	page = __buddy_alloc(area, GFP_PCP_BATCH_ORDER);
+	if (page >= 0) {
+		/* Hand out in ascending order */
+		for (i = GFP_PCP_BATCH; i > 0; i--)
+			pcp->pages[pcp->nr++] = page + i - 1;
+	} else {
+		while (pcp->nr < GFP_PCP_BATCH) {
+			page = __buddy_alloc(area, 0);
+			if (page < 0)
+				break;
+			pcp->pages[pcp->nr++] = page;
+		}
+	}
+	spin_unlock(&gfp_lock);
+
+	if (!pcp->nr)
+		return -ENOMEM;
+
+	return pcp->pages[--pcp->nr];
+}
+
+static void pcp_free(struct memory_area *area, unsigned long page)
+{
+	struct gfp_pcp *pcp = area_pcp(area);
+
+	if (pcp->nr == GFP_PCP_HIGH)
+		pcp_drain(area, GFP_PCP_HIGH - GFP_PCP_BATCH);
+
+	pcp->pages[pcp->nr++] = page;
+}
+
+static void memory_area_free(struct memory_area *area, unsigned long page,
+			     unsigned int pages)
+{
+	if (pages == 1) {
+		pcp_free(area, page);
+		return;
+	}
+
+	spin_lock(&gfp_lock);
+	__buddy_free_range(area, page, pages);
+	spin_unlock(&gfp_lock);
+}
+
 static int memory_area_alloc_aligned(struct memory_area *area, ptrdiff_t *off,
 				     unsigned int pages, unsigned int alignment,
 				     paddr_t hint)
 {
-	long page_offset;
+	unsigned int order;
+	long page;
 	int err;
 
 	if (hint == INVALID_PHYS_ADDR && !off)
 		panic("Invalid usage\n");
 
-	/* hint MUST arrive sanity checked */
-	if (hint != INVALID_PHYS_ADDR)
-		page_offset = (hint - area->p.base) / PAGE_SIZE;
-	else
-		page_offset = -1;
+	if (!pages || alignment % PAGE_SIZE)
+		return trace_error(-EINVAL);
 
-	spin_lock(&gfp_lock);
-	err = mm_bitmap_find_and_allocate(&area->bitmap, pages, page_offset,
-					  alignment);
-	spin_unlock(&gfp_lock);
-	if (err < 0)
-		return err;
+	/* hint MUST arrive sanity checked */
+	if (hint != INVALID_PHYS_ADDR) {
+		page = (hint - area->p.base) / PAGE_SIZE;
+
+		spin_lock(&gfp_lock);
+		err = __buddy_reserve(area, page, pages);
+		spin_unlock(&gfp_lock);
+		if (err == -ENOMEM) {
+			/* The pages might be cached on this CPU */
+			pcp_drain(area, 0);
+			spin_lock(&gfp_lock);
+			err = __buddy_reserve(area, page, pages);
+			spin_unlock(&gfp_lock);
+		}
+		if (err)
+			return err;
+	} else if (pages == 1 && alignment == PAGE_SIZE) {
+		page = pcp_alloc(area);
+		if (page < 0)
+			return page;
+	} else {
+		order = pages_to_order(max(pages, PAGES(alignment)));
+		if (order > GFP_MAX_ORDER)
+			return -ENOMEM;
+
+		spin_lock(&gfp_lock);
+		page = __buddy_alloc(area, order);
+		/* Give back the tail that exceeds the requested size */
+		if (page >= 0)
+			__buddy_free_range(area, page + pages,
+					   (1UL << order) - pages);
+		spin_unlock(&gfp_lock);
+		if (page < 0)
+			return page;
+	}
 
 	if (off)
-		*off = err * PAGE_SIZE;
+		*off = page * PAGE_SIZE;
 
 	return 0;
 }
@@ -215,12 +517,10 @@ int free_pages(const void *addr, unsigned int pages)
 		return -ENOENT;
 
 	start = (addr - area->v.base) / PAGE_SIZE;
-	if (start + pages > area->bitmap.bit_max)
+	if (start + pages > area->pages)
 		return -ERANGE;
 
-	spin_lock(&gfp_lock);
-	bitmap_clear(area->bitmap.bitmap, start, pages);
-	spin_unlock(&gfp_lock);
+	memory_area_free(area, start, pages);
 
 	return 0;
 }
@@ -261,17 +561,15 @@ _phys_pages_alloc(paddr_t *res, size_t pages, unsigned int alignment,
 int phys_free_pages(paddr_t phys, unsigned int pages)
 {
 	struct memory_area *area;
-	unsigned int i, start;
+	unsigned int i;
 
 	if (page_offset(phys))
 		return -EINVAL;
 
 	for_each_valid_memory_area(i, area) {
 		if (p_in_area(area, phys, pages)) {
-			start = (phys - area->p.base) / PAGE_SIZE;
-			spin_lock(&gfp_lock);
-			bitmap_clear(area->bitmap.bitmap, start, pages);
-			spin_unlock(&gfp_lock);
+			memory_area_free(area, (phys - area->p.base) / PAGE_SIZE,
+					 pages);
 			return 0;
 		}
 	}
@@ -279,6 +577,64 @@ int phys_free_pages(paddr_t phys, unsigned int pages)
 	return -ERANGE;
 }
 
+static atomic_t *phys_page_ref(paddr_t phys)
+{
+	struct memory_area *area;
+	unsigned int i;
+
+	if (page_offset(phys))
+		return NULL;
+
+	for_each_valid_memory_area(i, area)
+		if (p_in_area(area, phys, 1))
+			return area->refs ?
+				&area->refs[(phys - area->p.base) / PAGE_SIZE] :
+				NULL;
+
+	return NULL;
+}
+
+int phys_page_get(paddr_t phys)
+{
+	atomic_t *ref;
+
+	ref = phys_page_ref(phys);
+	if (!ref)
+		return -ERANGE;
+
+	atomic_fetch_add_relaxed(1, ref);
+
+	return 0;
+}
+
+int phys_page_put(paddr_t phys)
+{
+	atomic_t *ref;
+	int old;
+
+	ref = phys_page_ref(phys);
+	if (!ref)
+		return -ERANGE;
+
+	/* Without additional owners, we're the last one: release the page */
+	old = atomic_read(ref);
+	do {
+		if (!old)
+			return phys_free_pages(phys, 1);
+	} while (!atomic_try_cmpxchg_relaxed(ref, &old, old - 1));
+
+	return 0;
+}
+
+bool phys_page_shared(paddr_t phys)
+{
+	atomic_t *ref;
+
+	ref = phys_page_ref(phys);
+
+	return ref && atomic_read(ref);
+}
+
 int phys_pages_alloc(paddr_t *res, size_t pages, unsigned int alignment)
 {
 	return _phys_pages_alloc(res, pages, alignment, INVALID_PHYS_ADDR);
@@ -346,7 +702,9 @@ int __init kernel_mem_init(void)
 	pri("OS pages: %lu\n", num_os_pages());
 	pri("Internal page pool pages: %lu\n", internal_page_pool_pages());
 
-	/* mark OS pages as used */
+	/* Start with a completely free area, and mark OS pages as used */
+	buddy_init(KMM_AREA, kmm_buddy_bitmap, KMM_PAGES);
+	__buddy_free_range(KMM_AREA, 0, KMM_PAGES);
 	memory_areas[0].valid = true;
 	err = _alloc_pages_aligned(NULL, num_os_pages(), PAGE_SIZE,
 				   (void *)GRINCH_BASE);
@@ -368,6 +726,7 @@ int __init kernel_mem_init(void)
 static int __init create_memory_area(paddr_t addrp, size_t sizep, void *virt)
 {
 	struct memory_area *area;
+	unsigned long *words;
 	paddr_t pgrinch;
 	unsigned int i;
 	int err;
@@ -385,18 +744,20 @@ found_free_area:
 	spin_unlock(&gfp_lock);
 
 	area->p.base = addrp;
-	area->bitmap.bit_max = PAGES(sizep);
-	area->p.end= addrp + area->bitmap.bit_max * PAGE_SIZE;
+	area->p.end = addrp + PAGES(sizep) * PAGE_SIZE;
 
-	area->bitmap.bitmap = zalloc_pages(
-		PAGES(page_up(bitmap_size(area->bitmap.bit_max))));
-	if (!area->bitmap.bitmap) {
+	words = zalloc_pages(PAGES(page_up(BUDDY_WORDS(PAGES(sizep)) *
+					   sizeof(unsigned long))));
+	if (!words) {
 		err = -ENOMEM;
 		goto err_out;
 	}
+	buddy_init(area, words, PAGES(sizep));
+	__buddy_free_range(area, 0, area->pages);
+
 	if (virt) {
 		area->v.base = virt;
-		area->v.end = area->v.base + area->bitmap.bit_max * PAGE_SIZE;
+		area->v.end = area->v.base + area->pages * PAGE_SIZE;
 	} else
 		area->v.base = area->v.end = NULL;
 
@@ -417,6 +778,25 @@ err_out:
 
 }
 
+/*
+ * The reference counters are allocated once all boot-time reservations are
+ * in place, as they might be placed anywhere in memory.
+ */
+int __init phys_refs_init(void)
+{
+	struct memory_area *area;
+	unsigned int i;
+
+	for_each_valid_memory_area(i, area) {
+		area->refs = zalloc_pages(PAGES(page_up(area->pages *
+							sizeof(atomic_t))));
+		if (!area->refs)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static int __init phys_mem_init(struct mmio_area *area)
 {
 	int err;
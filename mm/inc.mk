@@ -3,8 +3,10 @@ MM_OBJS += asid.o
 MM_OBJS += gfp.o
 MM_OBJS += paging.o
 MM_OBJS += salloc.o
+MM_OBJS += slab.o
 MM_OBJS += ioremap.o
 MM_OBJS += mm.o
+MM_OBJS += mmap.o
 MM_OBJS += vma.o
 
 MM_OBJS := $(addprefix mm/, $(MM_OBJS))
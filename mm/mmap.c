@@ -0,0 +1,339 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#define dbg_fmt(x)	"mmap: " x
+
+#include <grinch/align.h>
+#include <grinch/alloc.h>
+#include <grinch/errno.h>
+#include <grinch/fs/vfs.h>
+#include <grinch/minmax.h>
+#include <grinch/mman_abi.h>
+#include <grinch/percpu.h>
+#include <grinch/syscall.h>
+#include <grinch/task.h>
+#include <grinch/uaccess.h>
+
+#define PROT_MASK	(PROT_READ | PROT_WRITE | PROT_EXEC)
+#define MAP_MASK	(MAP_SHARED | MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS)
+
+static unsigned int prot_to_vma_flags(int prot)
+{
+	unsigned int flags;
+
+	/* Not every architecture supports write-only mappings */
+	flags = 0;
+	if (prot & (PROT_READ | PROT_WRITE))
+		flags |= VMA_FLAG_R;
+	if (prot & PROT_WRITE)
+		flags |= VMA_FLAG_W;
+	if (prot & PROT_EXEC)
+		flags |= VMA_FLAG_X;
+
+	return flags;
+}
+
+static int check_range(const void __user *addr, size_t *length)
+{
+	size_t len;
+
+	len = page_up(*length);
+	if (!*length || len < *length)
+		return -EINVAL;
+
+	if (!PTR_PAGE_ALIGNED(addr) || !is_urange(addr, len))
+		return -EINVAL;
+
+	*length = len;
+
+	return 0;
+}
+
+/*
+ * Split the VMAs that straddle the boundaries of [base, base + size), so
+ * that the range only consists of whole VMAs. The heap must not be split, as
+ * the program break couldn't be moved any longer.
+ */
+static int uvmas_isolate(struct process *p, void __user *base, size_t size)
+{
+	struct vma *vma;
+	int err;
+
+	vma = uvma_at(p, base);
+	if (vma && vma->base != base) {
+		if (vma == p->brk.vma)
+			return -EINVAL;
+
+		err = uvma_split(p, vma, base);
+		if (err)
+			return err;
+	}
+
+	vma = uvma_at(p, base + size - 1);
+	if (vma && vma->base + vma->size != base + size) {
+		if (vma == p->brk.vma)
+			return -EINVAL;
+
+		err = uvma_split(p, vma, base + size);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int uvmas_unmap(struct process *p, void __user *base, size_t size)
+{
+	struct vma *vma, *next;
+	int err;
+
+	err = uvmas_isolate(p, base, size);
+	if (err)
+		return err;
+
+	for (vma = uvma_first(p, base, size); vma; vma = next) {
+		next = uvma_next(p, vma, base + size);
+
+		if (vma == p->brk.vma)
+			p->brk.vma = NULL;
+		uvma_remove(p, vma);
+	}
+
+	/* One shootdown for all VMAs of the range */
+	mm_flush_tlb(&p->mm);
+
+	return 0;
+}
+
+/* Resident contents of the file behind fd. Must hold the task's lock. */
+static const void *fd_contents(struct process *p, int fd, size_t *size)
+{
+	struct file_handle *handle;
+	const void *ret;
+
+	if (fd < 0 || fd >= MAX_FDS)
+		return ERR_PTR(-EBADF);
+
+	handle = &p->fds[fd];
+	if (!handle->fp)
+		return ERR_PTR(-EBADF);
+
+	if (!handle->flags.may_read)
+		return ERR_PTR(-EACCES);
+
+	ret = vfs_file_contents(handle->fp, size);
+	if (ret == ERR_PTR(-ENOSYS))
+		return ERR_PTR(-ENODEV);
+
+	return ret;
+}
+
+SYSCALL_DEF6(mmap, void __user *, addr, size_t, length, int, prot, int, flags,
+	     int, fd, unsigned long, offset)
+{
+	unsigned int vma_flags;
+	struct process *p;
+	size_t size, fsize;
+	const void *file;
+	struct task *task;
+	struct vma *vma;
+	long ret;
+
+	size = page_up(length);
+	if (!length || size < length)
+		return -EINVAL;
+
+	if (prot & ~PROT_MASK || flags & ~MAP_MASK)
+		return -EINVAL;
+
+	switch (flags & (MAP_SHARED | MAP_PRIVATE)) {
+	case MAP_PRIVATE:
+		break;
+	case MAP_SHARED:
+		/*
+		 * We have no shared writable mappings. Read-only ones aren't
+		 * any different from private ones.
+		 */
+		if (prot & PROT_WRITE)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!(flags & MAP_ANONYMOUS) && offset % PAGE_SIZE)
+		return -EINVAL;
+
+	vma_flags = prot_to_vma_flags(prot) | VMA_FLAG_LAZY;
+
+	task = current_task();
+	p = &task->process;
+	spin_lock(&task->lock);
+
+	file = NULL;
+	if (!(flags & MAP_ANONYMOUS)) {
+		file = fd_contents(p, fd, &fsize);
+		if (IS_ERR(file)) {
+			ret = PTR_ERR(file);
+			goto unlock_out;
+		}
+	}
+
+	if (flags & MAP_FIXED) {
+		ret = check_range(addr, &size);
+		if (ret)
+			goto unlock_out;
+
+		/* Fixed mappings replace whatever was mapped before */
+		ret = uvmas_unmap(p, addr, size);
+		if (ret)
+			goto unlock_out;
+	} else if (!addr || check_range(addr, &size) ||
+		   uvma_collides(p, addr, size)) {
+		/* Only take the hint, if it fits */
+		addr = uvma_find_free(p, size);
+		if (!addr) {
+			ret = -ENOMEM;
+			goto unlock_out;
+		}
+	}
+
+	vma = uvma_create(task, addr, size, vma_flags, NULL);
+	if (IS_ERR(vma)) {
+		ret = PTR_ERR(vma);
+		goto unlock_out;
+	}
+
+	/* Beyond the end of the file, the mapping is zero-filled */
+	if (file && offset < fsize) {
+		vma->file.base = file + offset;
+		vma->file.size = min(fsize - offset, size);
+	}
+
+	ret = (long)addr;
+
+unlock_out:
+	spin_unlock(&task->lock);
+	return ret;
+}
+
+SYSCALL_DEF2(munmap, void __user *, addr, size_t, length)
+{
+	struct task *task;
+	long ret;
+
+	ret = check_range(addr, &length);
+	if (ret)
+		return ret;
+
+	task = current_task();
+	spin_lock(&task->lock);
+	ret = uvmas_unmap(&task->process, addr, length);
+	spin_unlock(&task->lock);
+
+	return ret;
+}
+
+/* Bytes of [base, base + size) that are covered by VMAs */
+static size_t uvmas_covered(struct process *p, void __user *base, size_t size)
+{
+	void __user *start, *end;
+	struct vma *vma;
+	size_t covered;
+
+	covered = 0;
+	for (vma = uvma_first(p, base, size); vma;
+	     vma = uvma_next(p, vma, base + size)) {
+		start = vma->base < base ? base : vma->base;
+		end = vma->base + vma->size;
+		if (end > base + size)
+			end = base + size;
+		covered += end - start;
+	}
+
+	return covered;
+}
+
+SYSCALL_DEF3(mprotect, void __user *, addr, size_t, length, int, prot)
+{
+	unsigned int *old_flags, nr, i;
+	struct vma *vma, *first;
+	struct process *p;
+	struct task *task;
+	long ret;
+
+	if (prot & ~PROT_MASK)
+		return -EINVAL;
+
+	/*
+	 * Pages that are present can not be kept without any access rights.
+	 * Only mmap() may create inaccessible reservations.
+	 */
+	if (prot == PROT_NONE)
+		return -EINVAL;
+
+	ret = check_range(addr, &length);
+	if (ret)
+		return ret;
+
+	task = current_task();
+	p = &task->process;
+	spin_lock(&task->lock);
+
+	/* The whole range must be mapped. Check before anything is changed. */
+	if (uvmas_covered(p, addr, length) != length) {
+		ret = -ENOMEM;
+		goto unlock_out;
+	}
+
+	ret = uvmas_isolate(p, addr, length);
+	if (ret)
+		goto unlock_out;
+
+	first = uvma_first(p, addr, length);
+	nr = 0;
+	for (vma = first; vma; vma = uvma_next(p, vma, addr + length))
+		nr++;
+
+	/* Remember the previous rights, in case we have to roll back */
+	old_flags = kmalloc(nr * sizeof(*old_flags));
+	if (!old_flags) {
+		ret = -ENOMEM;
+		goto unlock_out;
+	}
+
+	for (i = 0, vma = first; vma;
+	     i++, vma = uvma_next(p, vma, addr + length)) {
+		old_flags[i] = vma->flags;
+		ret = uvma_protect(p, vma, prot_to_vma_flags(prot));
+		if (ret)
+			break;
+	}
+
+	/*
+	 * Protecting only fails if splitting a huge page runs out of memory.
+	 * Restore the rights of all VMAs that were touched, including the
+	 * failing one. Their huge pages were split already, so this should
+	 * not need any further memory.
+	 */
+	if (ret)
+		for (nr = i + 1, i = 0, vma = first; i < nr;
+		     i++, vma = uvma_next(p, vma, addr + length))
+			uvma_protect(p, vma, old_flags[i]);
+
+	kfree(old_flags);
+	mm_flush_tlb(&p->mm);
+
+unlock_out:
+	spin_unlock(&task->lock);
+	return ret;
+}
@@ -407,7 +407,7 @@ static int map_osmem(page_table_t root, void *vaddr, size_t size,
 	return map_range(root, vaddr, v2p(vaddr), size, flags);
 }
 
-paddr_t paging_get_phys(page_table_t pt, const void *_virt)
+paddr_t paging_lookup(page_table_t pt, const void *_virt, size_t *size)
 {
 	const struct paging *paging;
 	unsigned long virt;
@@ -417,6 +417,38 @@ paddr_t paging_get_phys(page_table_t pt, const void *_virt)
 	paging = root_paging;
 	virt = (unsigned long)_virt;
 
+	while (1) {
+		pte = paging->get_entry(pt, virt);
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS)) {
+			phys = INVALID_PHYS_ADDR;
+			break;
+		}
+
+		phys = paging->get_phys(pte, virt);
+		if (phys != INVALID_PHYS_ADDR)
+			break;
+
+		pt = p2v(paging->get_next_pt(pte));
+		paging++;
+	}
+
+	*size = paging_slot_size(paging);
+
+	return phys;
+}
+
+paddr_t paging_get_phys_run(page_table_t pt, const void *_virt, size_t max,
+			    size_t *len)
+{
+	const struct paging *paging;
+	unsigned long virt, size;
+	unsigned int entries;
+	pt_entry_t pte;
+	paddr_t phys;
+
+	paging = root_paging;
+	virt = (unsigned long)_virt;
+
 	while (1) {
 		pte = paging->get_entry(pt, virt);
 		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS))
@@ -424,13 +456,38 @@ paddr_t paging_get_phys(page_table_t pt, const void *_virt)
 
 		phys = paging->get_phys(pte, virt);
 		if (phys != INVALID_PHYS_ADDR)
-			return phys;
+			break;
 
 		pt = p2v(paging->get_next_pt(pte));
 		paging++;
 	}
 
-	return INVALID_PHYS_ADDR;
+	/*
+	 * Without descending again, extend the run along the remaining
+	 * entries of the same table, as long as they map contiguously.
+	 */
+	size = paging_slot_size(paging);
+	entries = PTES_PER_PT - 1 - (virt / size) % PTES_PER_PT;
+	*len = size - (virt & (size - 1));
+	while (*len < max && entries--) {
+		pte = paging->get_entry(pt, virt + *len);
+		if (!paging->entry_valid(pte, PAGE_PRESENT_FLAGS) ||
+		    paging->get_phys(pte, virt + *len) != phys + *len)
+			break;
+		*len += size;
+	}
+
+	if (*len > max)
+		*len = max;
+
+	return phys;
+}
+
+paddr_t paging_get_phys(page_table_t pt, const void *virt)
+{
+	size_t size;
+
+	return paging_lookup(pt, virt, &size);
 }
 
 int paging_discard_init(void)
@@ -464,7 +521,7 @@ int __init paging_init(unsigned long this_cpu)
 	pri("=== Grinch memory layout ===\n");
 	pri(" Grinch area: 0x%lx -- 0x%lx\n", GRINCH_BASE, GRINCH_END);
 	pri("ioremap area: 0x%lx -- 0x%lx\n", IOREMAP_BASE, IOREMAP_END);
-	pri("  kheap area: 0x%lx\n", KHEAP_BASE);
+	pri("  kheap area: 0x%lx -- 0x%lx\n", KHEAP_BASE, KHEAP_END);
 	pri(" direct phys: 0x%lx\n", DIR_PHYS_BASE);
 	pri("=== Grinch memory layout end ===\n");
 
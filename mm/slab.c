@@ -0,0 +1,241 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#define dbg_fmt(x)	"slab: " x
+
+#include <grinch/align.h>
+#include <grinch/gfp.h>
+#include <grinch/panic.h>
+#include <grinch/percpu.h>
+#include <grinch/printk.h>
+#include <grinch/slab.h>
+#include <grinch/string.h>
+
+#define SLAB_ALIGN	16
+#define SLAB_MIN_OBJS	8
+#define SLAB_MAX_ORDER	4
+
+/*
+ * A slab is a naturally aligned block of 1 << order pages. Its header sits at
+ * the beginning, so an object's slab is found by aligning the object's address
+ * down. Free objects are chained through their first word.
+ */
+struct slab {
+	struct kmem_cache *cache;
+	struct list_head list;
+	void *free;
+	unsigned int inuse;
+};
+
+#define SLAB_HDR_SIZE	ALIGN(sizeof(struct slab), SLAB_ALIGN)
+
+static DEFINE_SPINLOCK(slab_lock);
+static struct kmem_cache *caches[SLAB_MAX_CACHES];
+static unsigned int nr_caches;
+
+static inline size_t slab_bytes(struct kmem_cache *cache)
+{
+	return PAGE_SIZE << cache->order;
+}
+
+static inline struct slab *obj_to_slab(struct kmem_cache *cache,
+				       const void *obj)
+{
+	return (void *)((uintptr_t)obj & ~(slab_bytes(cache) - 1));
+}
+
+static inline struct kmem_magazine *this_magazine(struct kmem_cache *cache)
+{
+	return &this_per_cpu()->slab_mags[cache->id - 1];
+}
+
+/* Register the cache and choose its geometry */
+static void kmem_cache_setup(struct kmem_cache *cache)
+{
+	size_t size;
+
+	spin_lock(&slab_lock);
+	if (cache->id)
+		goto unlock_out;
+
+	if (nr_caches == SLAB_MAX_CACHES)
+		panic("slab: too many caches for %s\n", cache->name);
+
+	size = ALIGN(cache->size, SLAB_ALIGN);
+	for (cache->order = 0; cache->order < SLAB_MAX_ORDER; cache->order++)
+		if ((slab_bytes(cache) - SLAB_HDR_SIZE) / size >= SLAB_MIN_OBJS)
+			break;
+
+	cache->size = size;
+	cache->objs = (slab_bytes(cache) - SLAB_HDR_SIZE) / size;
+	if (!cache->objs)
+		panic("slab: objects of %s are too large\n", cache->name);
+
+	caches[nr_caches++] = cache;
+	/* Publish the ID last, it marks the cache as ready */
+	mb();
+	cache->id = nr_caches;
+
+unlock_out:
+	spin_unlock(&slab_lock);
+}
+
+/* must hold the cache's lock in all __slab_* routines */
+static struct slab *__slab_grow(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	unsigned int i;
+	void **obj;
+
+	slab = alloc_pages_aligned(1 << cache->order, slab_bytes(cache));
+	if (!slab)
+		return NULL;
+
+	slab->cache = cache;
+	slab->inuse = 0;
+	slab->free = NULL;
+	for (i = cache->objs; i > 0; i--) {
+		obj = (void *)slab + SLAB_HDR_SIZE + (i - 1) * cache->size;
+		*obj = slab->free;
+		slab->free = obj;
+	}
+
+	list_add(&slab->list, &cache->partial);
+	cache->nr_partial++;
+	cache->nr_slabs++;
+
+	return slab;
+}
+
+static void *__slab_get(struct kmem_cache *cache)
+{
+	struct slab *slab;
+	void **obj;
+
+	if (list_empty(&cache->partial)) {
+		slab = __slab_grow(cache);
+		if (!slab)
+			return NULL;
+	} else
+		slab = list_first_entry(&cache->partial, struct slab, list);
+
+	obj = slab->free;
+	slab->free = *obj;
+	slab->inuse++;
+
+	if (!slab->free) {
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->full);
+		cache->nr_partial--;
+	}
+
+	return obj;
+}
+
+static void __slab_put(struct kmem_cache *cache, void *obj)
+{
+	struct slab *slab;
+
+	slab = obj_to_slab(cache, obj);
+	if (slab->cache != cache)
+		panic("slab: %p does not belong to %s\n", obj, cache->name);
+
+	if (!slab->free) {
+		list_del(&slab->list);
+		list_add(&slab->list, &cache->partial);
+		cache->nr_partial++;
+	}
+
+	*(void **)obj = slab->free;
+	slab->free = obj;
+	slab->inuse--;
+
+	/* Keep one empty slab around, give back the others */
+	if (!slab->inuse && cache->nr_partial > 1) {
+		list_del(&slab->list);
+		cache->nr_partial--;
+		cache->nr_slabs--;
+		free_pages(slab, 1 << cache->order);
+	}
+}
+
+void *kmem_cache_alloc(struct kmem_cache *cache)
+{
+	struct kmem_magazine *mag;
+	void *obj;
+
+	if (!cache->id)
+		kmem_cache_setup(cache);
+
+	mag = this_magazine(cache);
+	if (!mag->nr) {
+		/* Refill half of the magazine */
+		spin_lock(&cache->lock);
+		while (mag->nr < SLAB_MAGAZINE_SIZE / 2) {
+			obj = __slab_get(cache);
+			if (!obj)
+				break;
+			mag->objs[mag->nr++] = obj;
+		}
+		spin_unlock(&cache->lock);
+
+		if (!mag->nr)
+			return NULL;
+	}
+
+	return mag->objs[--mag->nr];
+}
+
+void *kmem_cache_zalloc(struct kmem_cache *cache)
+{
+	void *obj;
+
+	obj = kmem_cache_alloc(cache);
+	if (obj)
+		memset(obj, 0, cache->size);
+
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *cache, const void *obj)
+{
+	struct kmem_magazine *mag;
+
+	if (!obj)
+		return;
+
+	mag = this_magazine(cache);
+	if (mag->nr == SLAB_MAGAZINE_SIZE) {
+		/* Flush half of the magazine */
+		spin_lock(&cache->lock);
+		while (mag->nr > SLAB_MAGAZINE_SIZE / 2)
+			__slab_put(cache, mag->objs[--mag->nr]);
+		spin_unlock(&cache->lock);
+	}
+
+	mag->objs[mag->nr++] = (void *)obj;
+}
+
+void kmem_caches_dump(void)
+{
+	struct kmem_cache *cache;
+	unsigned int i;
+
+	spin_lock(&slab_lock);
+	for (i = 0; i < nr_caches; i++) {
+		cache = caches[i];
+		pr("%-12s size: %4lu objs/slab: %3u slabs: %u (%u partial)\n",
+		   cache->name, cache->size, cache->objs, cache->nr_slabs,
+		   cache->nr_partial);
+	}
+	spin_unlock(&slab_lock);
+}
@@ -15,17 +15,128 @@
 #include <grinch/alloc.h>
 #include <grinch/align.h>
 #include <grinch/gfp.h>
+#include <grinch/minmax.h>
 #include <grinch/percpu.h>
 #include <grinch/paging.h>
 #include <grinch/panic.h>
 #include <grinch/printk.h>
+#include <grinch/slab.h>
 #include <grinch/task.h>
 #include <grinch/uaccess.h>
 
+static DEFINE_KMEM_CACHE(vma_cache, "vma", struct vma);
+
+/* Backs all anonymous pages that were only read so far */
+paddr_t zero_page;
+
+int __init zero_page_init(void)
+{
+	int err;
+
+	err = phys_pages_alloc(&zero_page, 1, PAGE_SIZE);
+	if (err)
+		return err;
+
+	/* This reference is never dropped, so the page is never released */
+	clear_page(p2v(zero_page));
+
+	return 0;
+}
+
+static mem_flags_t vma_mem_flags(const struct vma *vma)
+{
+	mem_flags_t flags;
+
+	flags = 0;
+	if (vma->flags & VMA_FLAG_R)
+		flags |= GRINCH_MEM_R;
+	if (vma->flags & VMA_FLAG_W)
+		flags |= GRINCH_MEM_W;
+	if (vma->flags & VMA_FLAG_USER)
+		flags |= GRINCH_MEM_U;
+	if (vma->flags & VMA_FLAG_X)
+		flags |= GRINCH_MEM_X;
+
+	return flags;
+}
+
+static inline bool
+vma_spans(const struct vma *vma, const void *base, size_t size)
+{
+	return base >= vma->base && base + size <= vma->base + vma->size;
+}
+
+/*
+ * Huge pages of user VMAs consist of small pages, each of them with its own
+ * reference count, so that huge pages can be split at any time.
+ */
+static bool phys_range_shared(paddr_t phys, size_t size)
+{
+	size_t off;
+
+	for (off = 0; off < size; off += PAGE_SIZE)
+		if (phys_page_shared(phys + off))
+			return true;
+
+	return false;
+}
+
+static int phys_range_get(paddr_t phys, size_t size)
+{
+	size_t off;
+	int err;
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		err = phys_page_get(phys + off);
+		if (err)
+			goto put_out;
+	}
+
+	return 0;
+
+put_out:
+	while (off) {
+		off -= PAGE_SIZE;
+		phys_page_put(phys + off);
+	}
+	return err;
+}
+
+static int phys_range_put(paddr_t phys, size_t size)
+{
+	size_t off;
+	int err;
+
+	/* Exclusively owned ranges go back in one piece */
+	if (!phys_range_shared(phys, size))
+		return phys_free_pages(phys, PAGES(size));
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		err = phys_page_put(phys + off);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/*
+ * Size of the mapping at base that can be handled as a whole: huge pages
+ * that lie completely within the VMA, small pages otherwise.
+ */
+static inline size_t
+vma_page_size(const struct vma *vma, const void *base, size_t size)
+{
+	if (size == MEGA_PAGE_SIZE && PTR_IS_ALIGNED(base, MEGA_PAGE_SIZE) &&
+	    vma_spans(vma, base, size))
+		return size;
+
+	return PAGE_SIZE;
+}
+
 static int vma_alloc_range(page_table_t pt, struct vma *vma, void *base,
 			   size_t size, unsigned int alignment)
 {
-	mem_flags_t flags;
 	paddr_t phys;
 	int err;
 
@@ -39,16 +150,7 @@ static int vma_alloc_range(page_table_t pt, struct vma *vma, void *base,
 	if (err)
 		return err;
 
-	flags = 0;
-	if (vma->flags & VMA_FLAG_R)
-		flags |= GRINCH_MEM_R;
-	if (vma->flags & VMA_FLAG_W)
-		flags |= GRINCH_MEM_W;
-	if (vma->flags & VMA_FLAG_USER)
-		flags |= GRINCH_MEM_U;
-	if (vma->flags & VMA_FLAG_X)
-		flags |= GRINCH_MEM_X;
-	err = map_range(pt, base, phys, size, flags);
+	err = map_range(pt, base, phys, size, vma_mem_flags(vma));
 	if (err)
 		goto free_out;
 
@@ -59,31 +161,81 @@ free_out:
 	return err;
 }
 
+/*
+ * Remote TLB shootdowns are batched: the address space either runs on this
+ * CPU, or on none at all, while it is modified. Its translations linger
+ * dormant on the other CPUs it ran on, and they only need to be gone before
+ * it is scheduled there again. So instead of one fence per modified range,
+ * the ranges are merged, and mm_flush_tlb() fences them at once.
+ */
+static void mm_defer_flush(struct mm *mm, void *base, size_t size)
+{
+	if (!mm->flush.end) {
+		mm->flush.start = base;
+		mm->flush.end = base + size;
+		return;
+	}
+
+	if (base < mm->flush.start)
+		mm->flush.start = base;
+	if (base + size > mm->flush.end)
+		mm->flush.end = base + size;
+}
+
+void mm_flush_tlb(struct mm *mm)
+{
+	if (!mm->flush.end)
+		return;
+
+	/*
+	 * Without an ASID, the address space either never ran, or it is
+	 * untagged and flushed on every activation. Either way, other CPUs
+	 * can't hold any of its translations.
+	 */
+	if (mm->asid)
+		flush_tlb_others_asid(mm->cpus, mm->asid, mm->flush.start,
+				      mm->flush.end - mm->flush.start);
+
+	mm->flush.start = NULL;
+	mm->flush.end = NULL;
+}
+
 static int
-uvma_dealloc_range(const struct mm *mm, struct vma *vma, void *base, size_t size)
+uvma_dealloc_range(struct mm *mm, struct vma *vma, void *base, size_t size)
 {
 	page_table_t pt = mm->page_table;
+	size_t psize;
 	paddr_t phys;
-	size_t step;
 	void *this;
 	int err;
 
-	step = (vma->flags & VMA_FLAG_LAZY) ? PAGE_SIZE : vma->size;
-	for (this = base; this < base + size; this += step) {
-		phys = paging_get_phys(pt, this);
-		if (phys == INVALID_PHYS_ADDR)
+	/*
+	 * Pages are released one by one: after a fork, any of them might be
+	 * shared copy-on-write with other address spaces. Huge pages that are
+	 * only partially covered are split by unmap_range().
+	 */
+	for (this = base; this < base + size; this += psize) {
+		phys = paging_lookup(pt, this, &psize);
+		if (phys == INVALID_PHYS_ADDR) {
+			/* Nothing is mapped up to the end of the slot */
+			this = PTR_ALIGN_DOWN(this, psize);
 			continue;
+		}
+
+		if (psize != MEGA_PAGE_SIZE || !PTR_IS_ALIGNED(this, psize) ||
+		    this + psize > base + size)
+			psize = PAGE_SIZE;
 
 		/*
 		 * Unmap (and thereby flush the TLB) before releasing the
 		 * backing pages: they must not be reusable while stale
 		 * translations still point at them.
 		 */
-		err = unmap_range(pt, this, step);
+		err = unmap_range(pt, this, psize);
 		if (err)
 			return -EINVAL;
 
-		err = phys_free_pages(phys, PAGES(step));
+		err = phys_range_put(phys, psize);
 		if (err)
 			return err;
 	}
@@ -93,24 +245,18 @@ uvma_dealloc_range(const struct mm *mm, struct vma *vma, void *base, size_t size
 	if (err)
 		return -EINVAL;
 
-	/*
-	 * unmap_range() flushed this CPU. The address space may have run on
-	 * others, where its translations linger dormant until it is
-	 * scheduled there again; shoot them down now, before that can
-	 * happen. A process runs on at most one CPU at a time, so batching
-	 * one fence per range is enough.
-	 */
-	flush_tlb_others_asid(mm->asid, base, size);
+	/* unmap_range() flushed this CPU, the others are up to our caller */
+	mm_defer_flush(mm, base, size);
 
 	return 0;
 }
 
-static int uvma_dealloc(const struct mm *mm, struct vma *vma)
+static int uvma_dealloc(struct mm *mm, struct vma *vma)
 {
 	return uvma_dealloc_range(mm, vma, vma->base, vma->size);
 }
 
-static void uvma_destroy(const struct mm *mm, struct vma *vma)
+static void uvma_destroy(struct mm *mm, struct vma *vma)
 {
 	int err;
 
@@ -142,25 +288,97 @@ int kvma_create(struct vma *vma)
 	return 0;
 }
 
+/* Release the single pages that back [base, base + size) of a kernel VMA */
+static void kvma_dealloc_pages(void *base, size_t size)
+{
+	paddr_t phys;
+	void *this;
+
+	for (this = base; this < base + size; this += PAGE_SIZE) {
+		phys = paging_get_phys(kernel_root, this);
+		if (unmap_range(kernel_root, this, PAGE_SIZE))
+			BUG();
+		phys_free_pages(phys, 1);
+	}
+}
+
+/*
+ * Back the increase bytes behind the end of a kernel VMA, and extend the VMA
+ * accordingly. The root-level entries of the range must already exist.
+ */
+int kvma_grow(struct vma *vma, size_t increase)
+{
+	void *end = vma->base + vma->size;
+	size_t done;
+	int err;
+
+	if (increase % PAGE_SIZE)
+		return -EINVAL;
+
+	/* Prefer contiguous memory, but scattered pages will do as well */
+	err = vma_alloc_range(kernel_root, vma, end, increase, PAGE_SIZE);
+	if (err == -ENOMEM) {
+		for (done = 0; done < increase; done += PAGE_SIZE) {
+			err = vma_alloc_range(kernel_root, vma, end + done,
+					      PAGE_SIZE, PAGE_SIZE);
+			if (err) {
+				kvma_dealloc_pages(end, done);
+				return err;
+			}
+		}
+	} else if (err)
+		return err;
+
+	/*
+	 * map_range() only flushed this CPU, but others may have cached the
+	 * range while it was unmapped.
+	 */
+	flush_tlb_all();
+
+	vma->size += increase;
+
+	return 0;
+}
+
 static struct vma *
 __uvma_at(const struct process *p, const void __user *base, size_t size)
 {
+	struct rb_node *node;
 	struct vma *vma;
 
 	/* Overflow and sanity check */
 	if (base + size < base || !size)
 		BUG();
 
-	list_for_each_entry(vma, &p->mm.vmas, vmas)
-		if (base + size > vma->base && base < vma->base + vma->size)
+	/* VMAs don't overlap, so any overlapping VMA is on the search path */
+	node = p->mm.vma_tree.node;
+	while (node) {
+		vma = rb_entry(node, struct vma, node);
+		if (base + size <= vma->base)
+			node = node->left;
+		else if (base >= vma->base + vma->size)
+			node = node->right;
+		else
 			return vma;
+	}
 
 	return NULL;
 }
 
-struct vma *uvma_at(const struct process *p, const void __user *base)
+struct vma *uvma_at(struct process *p, const void __user *base)
 {
-	return __uvma_at(p, base, 1);
+	struct vma *vma;
+
+	/* Faults and user accesses tend to hit the same VMA over and over */
+	vma = p->mm.vma_cache;
+	if (vma && base >= vma->base && base < vma->base + vma->size)
+		return vma;
+
+	vma = __uvma_at(p, base, 1);
+	if (vma)
+		p->mm.vma_cache = vma;
+
+	return vma;
 }
 
 bool uvma_collides(const struct process *p, const void __user *base, size_t size)
@@ -168,33 +386,120 @@ bool uvma_collides(const struct process *p, const void __user *base, size_t size
 	return __uvma_at(p, base, size) ? true : false;
 }
 
-void uvmas_destroy(struct process *p)
+/* The lowest VMA that overlaps with [base, base + size) */
+struct vma *
+uvma_first(const struct process *p, const void __user *base, size_t size)
 {
-	struct list_head *pos, *q;
-	struct vma *tmp;
+	struct rb_node *node;
+	struct vma *vma, *ret;
 
-	list_for_each_safe(pos, q, &p->mm.vmas) {
-		tmp = list_entry(pos, struct vma, vmas);
-		uvma_destroy(&p->mm, tmp);
-		list_del(pos);
-		kfree(tmp);
+	if (base + size < base || !size)
+		BUG();
+
+	/* Overlapping VMAs further left have lower bases */
+	ret = NULL;
+	node = p->mm.vma_tree.node;
+	while (node) {
+		vma = rb_entry(node, struct vma, node);
+		if (base + size <= vma->base) {
+			node = node->left;
+		} else if (base >= vma->base + vma->size) {
+			node = node->right;
+		} else {
+			ret = vma;
+			node = node->left;
+		}
 	}
+
+	return ret;
 }
 
-struct vma *uvma_create(struct task *t, void *base, size_t size,
-		        unsigned int vma_flags, const char *name)
+/* The VMA after vma that still overlaps with the range up to end */
+struct vma *
+uvma_next(const struct process *p, const struct vma *vma, const void *end)
+{
+	void __user *next;
+
+	next = vma->base + vma->size;
+	if (next >= end)
+		return NULL;
+
+	return uvma_first(p, next, end - next);
+}
+
+/* Find a free range for a new mapping, top-down from USER_MMAP_TOP */
+void __user *uvma_find_free(const struct process *p, size_t size)
+{
+	void __user *top;
+	struct vma *vma;
+
+	top = (void __user *)USER_MMAP_TOP;
+	while (size && top - size >= (void __user *)USER_START &&
+	       top - size < top) {
+		vma = __uvma_at(p, top - size, size);
+		if (!vma)
+			return top - size;
+		top = vma->base;
+	}
+
+	return NULL;
+}
+
+static void uvma_link(struct mm *mm, struct vma *vma)
+{
+	struct rb_node **link, *parent;
+	struct vma *this;
+
+	link = &mm->vma_tree.node;
+	parent = NULL;
+	while (*link) {
+		parent = *link;
+		this = rb_entry(parent, struct vma, node);
+		link = vma->base < this->base ? &parent->left : &parent->right;
+	}
+
+	rb_link_node(&vma->node, parent, link);
+	rb_insert_color(&vma->node, &mm->vma_tree);
+	list_add(&vma->vmas, &mm->vmas);
+}
+
+static void uvma_unlink(struct mm *mm, struct vma *vma)
+{
+	if (mm->vma_cache == vma)
+		mm->vma_cache = NULL;
+
+	rb_erase(&vma->node, &mm->vma_tree);
+	list_del(&vma->vmas);
+}
+
+void uvma_remove(struct process *p, struct vma *vma)
+{
+	uvma_destroy(&p->mm, vma);
+	uvma_unlink(&p->mm, vma);
+	kmem_cache_free(&vma_cache, vma);
+}
+
+void uvmas_destroy(struct process *p)
+{
+	struct vma *vma, *tmp;
+
+	list_for_each_entry_safe(vma, tmp, &p->mm.vmas, vmas)
+		uvma_remove(p, vma);
+}
+
+static struct vma *uvma_new(const struct process *p, void *base, size_t size,
+			    unsigned int vma_flags, const char *name)
 {
 	struct vma *vma;
-	int err;
 
 	if (!is_urange(base, size))
 		return ERR_PTR(-ERANGE);
 
 	/* Check that the VMA won't collide with any other VMA */
-	if (uvma_collides(&t->process, base, size))
+	if (uvma_collides(p, base, size))
 		return ERR_PTR(-EINVAL);
 
-	vma = kmalloc(sizeof(*vma));
+	vma = kmem_cache_alloc(&vma_cache);
 	if (!vma)
 		return ERR_PTR(-ENOMEM);
 
@@ -204,16 +509,33 @@ struct vma *uvma_create(struct task *t, void *base, size_t size,
 	if (name) {
 		vma->name = kstrdup(name);
 		if (!vma->name) {
-			kfree(vma);
+			kmem_cache_free(&vma_cache, vma);
 			return ERR_PTR(-ENOMEM);
 		}
 	} else
 		vma->name = NULL;
 
+	vma->file.base = NULL;
+	vma->file.size = 0;
+
+	return vma;
+}
+
+struct vma *uvma_create(struct task *t, void *base, size_t size,
+		        unsigned int vma_flags, const char *name)
+{
+	struct vma *vma;
+	int err;
+
+	vma = uvma_new(&t->process, base, size, vma_flags, name);
+	if (IS_ERR(vma))
+		return vma;
+
 	if (!(vma->flags & VMA_FLAG_LAZY)) {
 		err = vma_alloc(t->process.mm.page_table, vma, PAGE_SIZE);
 		if (err) {
-			kfree(vma);
+			kfree(vma->name);
+			kmem_cache_free(&vma_cache, vma);
 			return ERR_PTR(err);
 		}
 
@@ -221,60 +543,346 @@ struct vma *uvma_create(struct task *t, void *base, size_t size,
 		umemset(t, vma->base, 0, vma->size);
 	}
 
-	list_add(&vma->vmas, &t->process.mm.vmas);
+	uvma_link(&t->process.mm, vma);
 
 	return vma;
 }
 
+/*
+ * Instead of copying, share all present pages of the VMA with dst. Writable
+ * pages are mapped read-only on both sides, and the first write to them
+ * copies the page, see uvma_cow().
+ */
 int uvma_duplicate(struct task *dst, struct task *src, struct vma *vma)
 {
-	void *base, __user *psrc;
+	mem_flags_t flags;
 	struct vma *new;
+	paddr_t phys;
+	size_t size;
+	void *base;
 	int err;
 
-	new = uvma_create(dst, vma->base, vma->size, vma->flags, vma->name);
+	new = uvma_new(&dst->process, vma->base, vma->size, vma->flags,
+		       vma->name);
 	if (IS_ERR(new))
 		return PTR_ERR(new);
+	new->file = vma->file;
 
-	for (base = vma->base; base < vma->base + vma->size;
-	     base += PAGE_SIZE) {
-		psrc = user_to_direct(&src->process.mm, base);
+	/* If anything fails, the caller destroys dst's VMAs, including ours */
+	uvma_link(&dst->process.mm, new);
+
+	flags = vma_mem_flags(vma) & ~GRINCH_MEM_W;
+	for (base = vma->base; base < vma->base + vma->size; base += size) {
+		phys = paging_lookup(src->process.mm.page_table, base, &size);
 		/* Skip non-allocated pages */
-		if (!psrc)
+		if (phys == INVALID_PHYS_ADDR) {
+			base = PTR_ALIGN_DOWN(base, size);
 			continue;
+		}
+
+		/* Huge pages are shared as a whole */
+		size = vma_page_size(vma, base, size);
+		err = phys_range_get(phys, size);
+		if (err)
+			return err;
 
-		if (new->flags & VMA_FLAG_LAZY) {
-			err = uvma_handle_fault(dst, new, base);
+		err = map_range(dst->process.mm.page_table, base, phys, size,
+				flags);
+		if (err) {
+			phys_range_put(phys, size);
+			return err;
+		}
+
+		if (vma->flags & VMA_FLAG_W) {
+			err = map_range(src->process.mm.page_table, base, phys,
+					size, flags);
 			if (err)
 				return err;
 		}
-
-		copy_to_user(dst, base, psrc, PAGE_SIZE);
 	}
 
+	if (vma->flags & VMA_FLAG_W)
+		mm_defer_flush(&src->process.mm, vma->base, vma->size);
+
 	return 0;
 }
 
-int uvma_handle_fault(struct task *t, struct vma *vma, void __user *addr)
+/* Resolve a write to a present, but write-protected page of a writable VMA */
+static int uvma_cow(struct task *t, struct vma *vma, void *base, paddr_t phys,
+		    size_t size)
+{
+	struct mm *mm = &t->process.mm;
+	paddr_t copy;
+	void *huge;
+	int err;
+
+	/*
+	 * Huge pages that are no longer shared at all keep being huge.
+	 * Otherwise, only the faulting page is copied, and mapping it splits
+	 * the huge page.
+	 */
+	huge = PTR_ALIGN_DOWN(base, MEGA_PAGE_SIZE);
+	if (vma_page_size(vma, huge, size) == MEGA_PAGE_SIZE) {
+		copy = phys - (base - huge);
+		if (!phys_range_shared(copy, size))
+			return map_range(mm->page_table, huge, copy, size,
+					 vma_mem_flags(vma));
+	}
+
+	/* The page is no longer shared, simply reclaim write access */
+	if (!phys_page_shared(phys))
+		return map_range(mm->page_table, base, phys, PAGE_SIZE,
+				 vma_mem_flags(vma));
+
+	err = phys_pages_alloc(&copy, 1, PAGE_SIZE);
+	if (err)
+		return err;
+
+	if (phys == zero_page)
+		clear_page(p2v(copy));
+	else
+		copy_page(p2v(copy), p2v(phys));
+
+	err = map_range(mm->page_table, base, copy, PAGE_SIZE,
+			vma_mem_flags(vma));
+	if (err) {
+		phys_free_pages(copy, 1);
+		return err;
+	}
+
+	/* No CPU must keep reading the shared page through a stale entry */
+	mm_defer_flush(mm, base, PAGE_SIZE);
+	mm_flush_tlb(mm);
+
+	return phys_page_put(phys);
+}
+
+/* Fault in a page of the file-backed part of a VMA */
+static int
+uvma_fault_file(struct task *t, struct vma *vma, void *base, bool is_write)
+{
+	page_table_t pt = t->process.mm.page_table;
+	const void *src;
+	paddr_t phys;
+	size_t len;
+	int err;
+
+	src = vma->file.base + (base - vma->base);
+	len = min(vma->file.size - (base - vma->base), (size_t)PAGE_SIZE);
+
+	/*
+	 * Complete, page-aligned pages of the file are mapped directly. They
+	 * remain owned by the file, so they are read-only for us, and writes
+	 * will be resolved via copy-on-write.
+	 */
+	if (!is_write && len == PAGE_SIZE && PTR_PAGE_ALIGNED(src)) {
+		phys = v2p(src);
+		err = phys_page_get(phys);
+		if (err)
+			return err;
+
+		err = map_range(pt, base, phys, PAGE_SIZE,
+				vma_mem_flags(vma) & ~GRINCH_MEM_W);
+		if (err)
+			phys_page_put(phys);
+		return err;
+	}
+
+	err = phys_pages_alloc(&phys, 1, PAGE_SIZE);
+	if (err)
+		return err;
+
+	/* Only the tail beyond the file's contents needs zeroing */
+	memcpy(p2v(phys), src, len);
+	memset(p2v(phys) + len, 0, PAGE_SIZE - len);
+
+	err = map_range(pt, base, phys, PAGE_SIZE, vma_mem_flags(vma));
+	if (err)
+		phys_free_pages(phys, 1);
+
+	return err;
+}
+
+/*
+ * Back the anonymous part of a lazy VMA with a huge page, if the naturally
+ * aligned huge page around base lies within that part, and if nothing of it
+ * is mapped yet. unmapped is the size of the unmapped region around base.
+ */
+static int
+uvma_fault_huge(struct task *t, struct vma *vma, void *base, size_t unmapped)
+{
+	paddr_t phys;
+	size_t off;
+	void *huge;
+	int err;
+
+	huge = PTR_ALIGN_DOWN(base, MEGA_PAGE_SIZE);
+	if (unmapped < MEGA_PAGE_SIZE || huge < vma->base + vma->file.size ||
+	    !vma_spans(vma, huge, MEGA_PAGE_SIZE))
+		return -ERANGE;
+
+	err = phys_pages_alloc(&phys, PAGES(MEGA_PAGE_SIZE), MEGA_PAGE_SIZE);
+	if (err)
+		return err;
+
+	for (off = 0; off < MEGA_PAGE_SIZE; off += PAGE_SIZE)
+		clear_page(p2v(phys) + off);
+
+	err = map_range(t->process.mm.page_table, huge, phys, MEGA_PAGE_SIZE,
+			vma_mem_flags(vma));
+	if (err)
+		phys_free_pages(phys, PAGES(MEGA_PAGE_SIZE));
+
+	return err;
+}
+
+static int uvma_fault_zero(struct task *t, struct vma *vma, void *base)
 {
+	int err;
+
+	err = phys_page_get(zero_page);
+	if (err)
+		return err;
+
+	err = map_range(t->process.mm.page_table, base, zero_page, PAGE_SIZE,
+			vma_mem_flags(vma) & ~GRINCH_MEM_W);
+	if (err)
+		phys_page_put(zero_page);
+
+	return err;
+}
+
+int uvma_handle_fault(struct task *t, struct vma *vma, void __user *addr,
+		      bool is_write)
+{
+	paddr_t phys;
+	size_t size;
 	void *base;
 	int err;
 
+	/* VMAs without any access rights never receive pages */
+	if (!(vma->flags & VMA_FLAG_RWX))
+		return -EFAULT;
+
+	base = PTR_PAGE_ALIGN_DOWN(addr);
+	phys = paging_lookup(t->process.mm.page_table, base, &size);
+	if (phys != INVALID_PHYS_ADDR) {
+		/* Present pages only fault on writes to copy-on-write pages */
+		if (!is_write || !(vma->flags & VMA_FLAG_W))
+			return -EFAULT;
+
+		return uvma_cow(t, vma, base, phys, size);
+	}
+
 	if (!(vma->flags & VMA_FLAG_LAZY))
 		BUG();
 
-	base = PTR_PAGE_ALIGN_DOWN(addr);
-	err = vma_alloc_range(t->process.mm.page_table, vma, base,
-			      PAGE_SIZE, PAGE_SIZE);
+	if (base < vma->base + vma->file.size)
+		return uvma_fault_file(t, vma, base, is_write);
+
+	/*
+	 * Reads see the shared zero page until the first write, which copies
+	 * it. Writes prefer a huge page, and fall back to a small one.
+	 */
+	if (!is_write)
+		return uvma_fault_zero(t, vma, base);
+
+	if (!uvma_fault_huge(t, vma, base, size))
+		return 0;
+
+	err = phys_pages_alloc(&phys, 1, PAGE_SIZE);
 	if (err)
 		return err;
 
-	umemset(t, base, 0, PAGE_SIZE);
+	/* Zero the page before the user can see it */
+	clear_page(p2v(phys));
+
+	err = map_range(t->process.mm.page_table, base, phys, PAGE_SIZE,
+			vma_mem_flags(vma));
+	if (err)
+		phys_free_pages(phys, 1);
+
+	return err;
+}
+
+/* Split the VMA at a page boundary. The upper part becomes a new VMA. */
+int uvma_split(struct process *p, struct vma *vma, void *at)
+{
+	struct vma *upper;
+	size_t off;
+
+	if (!PTR_PAGE_ALIGNED(at) || at <= vma->base ||
+	    at >= vma->base + vma->size)
+		return -EINVAL;
+
+	upper = kmem_cache_alloc(&vma_cache);
+	if (!upper)
+		return -ENOMEM;
+
+	*upper = *vma;
+	if (vma->name) {
+		upper->name = kstrdup(vma->name);
+		if (!upper->name) {
+			kmem_cache_free(&vma_cache, upper);
+			return -ENOMEM;
+		}
+	}
+
+	off = at - vma->base;
+	upper->base = at;
+	upper->size = vma->size - off;
+	vma->size = off;
+
+	if (vma->file.size > off) {
+		upper->file.base = vma->file.base + off;
+		upper->file.size = vma->file.size - off;
+		vma->file.size = off;
+	} else {
+		upper->file.base = NULL;
+		upper->file.size = 0;
+	}
+
+	uvma_link(&p->mm, upper);
+
+	return 0;
+}
+
+/* Change the access rights of a VMA, and of all of its present pages */
+int uvma_protect(struct process *p, struct vma *vma,
+		 unsigned int vma_flags)
+{
+	page_table_t pt = p->mm.page_table;
+	mem_flags_t flags;
+	size_t size;
+	paddr_t phys;
+	void *this;
+	int err;
+
+	vma->flags = (vma->flags & ~VMA_FLAG_RWX) | (vma_flags & VMA_FLAG_RWX);
+	flags = vma_mem_flags(vma);
+
+	for (this = vma->base; this < vma->base + vma->size; this += size) {
+		phys = paging_lookup(pt, this, &size);
+		if (phys == INVALID_PHYS_ADDR) {
+			this = PTR_ALIGN_DOWN(this, size);
+			continue;
+		}
+
+		/* Shared pages must stay write-protected for copy-on-write */
+		size = vma_page_size(vma, this, size);
+		err = map_range(pt, this, phys, size,
+				phys_range_shared(phys, size) ?
+				flags & ~GRINCH_MEM_W : flags);
+		if (err)
+			return err;
+	}
+
+	mm_defer_flush(&p->mm, vma->base, vma->size);
 
 	return 0;
 }
 
-int uvma_resize(const struct process *p, struct vma *vma, size_t size)
+int uvma_resize(struct process *p, struct vma *vma, size_t size)
 {
 	int err;
 
@@ -299,6 +907,7 @@ int uvma_resize(const struct process *p, struct vma *vma, size_t size)
 	if (size < vma->size) {
 		err = uvma_dealloc_range(&p->mm, vma,
 					 vma->base + size, vma->size - size);
+		mm_flush_tlb(&p->mm);
 		if (err)
 			return err;
 	} else {
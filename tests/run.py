@@ -103,9 +103,11 @@ class Qemu:
     unconditional; QEMU never escapes into the background.
     """
 
-    def __init__(self, build_dir, *, cpus=1, log_path=None, tee=False):
+    def __init__(self, build_dir, *, cpus=1, append='', log_path=None,
+                 tee=False):
         self.build_dir = build_dir
         self.cpus = cpus
+        self.append = append
         self.log_path = log_path
         self.tee = tee
         self.proc = None
@@ -121,10 +123,13 @@ class Qemu:
             self._log = open(self.log_path, 'wb')
         # start_new_session so we can SIGKILL the whole tree if make or
         # QEMU refuses to die politely.
+        cmd = ['make', '-C', str(self.build_dir), 'qemu',
+               'QEMU_DISPLAY=none', f'QEMU_CPUS={self.cpus}',
+               f'QEMU_SERIAL=tcp:127.0.0.1:{SERIAL_PORT},server']
+        if self.append:
+            cmd.append(f'QEMU_APPEND={self.append}')
         self.proc = subprocess.Popen(
-            ['make', '-C', str(self.build_dir), 'qemu',
-             'QEMU_DISPLAY=none', f'QEMU_CPUS={self.cpus}',
-             f'QEMU_SERIAL=tcp:127.0.0.1:{SERIAL_PORT},server'],
+            cmd,
             stdin=subprocess.DEVNULL,
             stdout=subprocess.DEVNULL,
             stderr=subprocess.DEVNULL,
@@ -253,19 +258,21 @@ class Test:
     name: str
     fn: object          # callable(Qemu) -> None
     requires: dict      # optional {'arch','opt','feature'} filter
+    append: str = ''    # extra kernel command line
 
 
 TESTS = []
 
 
-def test(name, **requires):
+def test(name, append='', **requires):
     """Register the decorated function as a test.
 
     Optional keyword filters restrict the test to matching variants,
     e.g. ``@test('smp', arch='riscv64')`` skips it on riscv32.
+    ``append`` is passed on to the kernel command line.
     """
     def register(fn):
-        TESTS.append(Test(name, fn, requires))
+        TESTS.append(Test(name, fn, requires, append))
         return fn
     return register
 
@@ -356,6 +363,11 @@ def _test_app(q):
     q.send('test')
     q.expect(rb'Testing Syscalls')
     q.expect(rb'Testing fork\+wait')
+    q.expect(rb'Testing copy-on-write')
+    q.expect(rb'Testing mmap')
+    q.expect(rb'Testing huge pages')
+    q.expect(rb'Testing scheduling policies')
+    q.expect(rb'Testing pipes')
     q.expect(rb'Testing VFS API')
     q.expect(rb' -> devfs')
     q.expect(rb' -> initrd')
@@ -375,6 +387,16 @@ def _schedtest(q):
     expect_exit_ok(q)
 
 
+@test('schedtest-nohz', append='nohz')
+def _schedtest_nohz(q):
+    """Same as ``schedtest``, but with the tick stopped on idle CPUs and
+    CPUs that run a single task. Sleepers must still be woken by their
+    own timers, and queued tasks must bring the tick back."""
+    q.expect(PROMPT)
+    q.send('schedtest')
+    expect_exit_ok(q)
+
+
 # TODO: Enable once jittertest can be made to return (see project TODO —
 # pass argv to init= so a finite run count can be configured).
 # @test('vm', arch='riscv64', feature='vmm')
@@ -450,7 +472,8 @@ def run_one_test(t, build_dir, log_path, verbose, cpus):
     """Run one test. Return None on success, TestError on failure."""
     try:
         with alarm(HARD_TIMEOUT), \
-             Qemu(build_dir, cpus=cpus, log_path=log_path, tee=verbose >= 3) as q:
+             Qemu(build_dir, cpus=cpus, append=t.append, log_path=log_path,
+                  tee=verbose >= 3) as q:
             t.fn(q)
         return None
     except Timeout as e:
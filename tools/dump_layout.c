@@ -21,7 +21,7 @@ int main(void)
 	printf("  Grinch Base: 0x%16lx\n", GRINCH_BASE);
 	printf("  Grinch Size: %luKiB\n", GRINCH_SIZE / 1024);
 	printf("    I/O Remap: 0x%16lx -- 0x%16lx\n", IOREMAP_BASE, IOREMAP_END);
-	printf("   kheap Base: 0x%16lx\n", KHEAP_BASE);
+	printf("        kheap: 0x%16lx -- 0x%16lx\n", KHEAP_BASE, KHEAP_END);
 	printf("Dir phys Base: 0x%16lx\n", DIR_PHYS_BASE);
 	printf("\n");
 	printf("   User Start: 0x%16lx\n", USER_START);
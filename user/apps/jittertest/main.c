@@ -11,6 +11,7 @@
  */
 
 #include <errno.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -71,18 +72,33 @@ err:
 
 int main(int argc, char *argv[])
 {
+	struct sched_param param;
 	unsigned int i, jitter, shots;
 	unsigned long max_shots;
 	int err;
 
-	if (argc > 2) {
+	/* jittertest [runs] [SCHED_FIFO priority] */
+	if (argc > 3) {
 		dprintf(STDERR_FILENO, "Invalid arguments!\n");
 		return -EINVAL;
-	} else if (argc == 2)
+	}
+
+	if (argc >= 2)
 		max_shots = strtoul(argv[1], NULL, 0);
 	else
 		max_shots = -1;
 
+	if (argc == 3) {
+		param.sched_priority = strtoul(argv[2], NULL, 0);
+		err = sched_setscheduler(0, SCHED_FIFO, &param);
+		if (err) {
+			perror("sched_setscheduler");
+			return -errno;
+		}
+		printf("Running with SCHED_FIFO priority %d\n",
+		       param.sched_priority);
+	}
+
 	printf("Starting Jittertest with %ld runs\n", max_shots);
 	err = 0;
 	for (shots = 0; shots < max_shots;) {
@@ -85,8 +85,8 @@ static int ls_file_dirent(const char *path, struct dirent *dent)
 static int ls_dir(const char *path)
 {
 	struct dirent *dent;
-	int i, fd, err;
-	char buf[256];
+	int i, fd, entries, err;
+	char buf[4096];
 
 	fd = open(path, 0);
 	if (fd == -1) {
@@ -95,24 +95,26 @@ static int ls_dir(const char *path)
 	}
 
 	printf("Content of directory %s\n", path);
+	err = 0;
 	for (;;) {
-		err = getdents(fd, (void *)buf, sizeof(buf));
-		if (err == 0)
+		entries = getdents(fd, (void *)buf, sizeof(buf));
+		if (entries == 0)
 			break;
-		if (err < 0) {
+		if (entries < 0) {
 			err = -errno;
 			break;
 		}
 
 		dent = (void *)buf;
-		for (i = 0; i < err; i++) {
+		for (i = 0; i < entries; i++) {
 			err = ls_file_dirent(path, dent);
 			if (err)
-				break;
-			dent = (void *)(dent + 1) + strlen(dent->d_name);
+				goto close_out;
+			dent = (void *)dent + dent->d_reclen;
 		}
 	}
 
+close_out:
 	close(fd);
 
 	return err;
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <sched.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include <sys/wait.h>
@@ -22,7 +23,7 @@
 #define SCHED_YIELD_EVERY	7
 #define SCHED_SLEEP_EVERY	257
 
-int main(void);
+int main(int argc, char *argv[]);
 
 static int sched_child(unsigned int child_no)
 {
@@ -59,13 +60,20 @@ static int sched_child(unsigned int child_no)
 	return acc ? 0 : -EINVAL;
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
-	unsigned int created, reaped;
+	unsigned int children, created, reaped;
 	int status, err;
 	pid_t child;
 
-	for (created = 0; created < NO_SCHED_CHILDREN; created++) {
+	/* The number of children may be scaled up: schedtest [children] */
+	children = NO_SCHED_CHILDREN;
+	if (argc > 2)
+		return -EINVAL;
+	if (argc == 2)
+		children = strtoul(argv[1], NULL, 0);
+
+	for (created = 0; created < children; created++) {
 		child = fork();
 		if (child == 0)
 			exit(sched_child(created) ? 1 : 0);
@@ -11,14 +11,25 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <string.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 
 #include "syscalls.h"
 
 #define NO_FORKS	50
 
+/* Exceeds the capacity of a pipe, so that the writer has to block */
+#define PIPE_BYTES	(3 * 4096 + 123)
+
+static int cow_data = 42;
+static char pipe_data[PIPE_BYTES];
+
 static int test_fork(void)
 {
 	unsigned int i;
@@ -62,6 +73,327 @@ static int test_fork(void)
 	return err;
 }
 
+static int test_cow(void)
+{
+	char cwd[32];
+	int status;
+	pid_t child;
+
+	cwd[0] = 'x';
+	child = fork();
+	if (child == -1) {
+		perror("fork");
+		return -errno;
+	} else if (child == 0) {
+		/* Write from userspace, and let the kernel write to us */
+		if (cow_data != 42)
+			exit(1);
+		cow_data = 23;
+		if (!getcwd(cwd, sizeof(cwd)))
+			exit(2);
+		exit(cow_data == 23 ? 0 : 3);
+	}
+
+	if (waitpid(child, &status, 0) != child) {
+		perror("waitpid");
+		return -errno;
+	}
+
+	if (WEXITSTATUS(status)) {
+		printf("Child failed: %d\n", WEXITSTATUS(status));
+		return -EINVAL;
+	}
+
+	/* The child's writes must not leak into our address space */
+	if (cow_data != 42 || cwd[0] != 'x') {
+		printf("Child modified parent memory\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int test_mmap(void)
+{
+	char buf[64], *map;
+	unsigned int i;
+	int err, fd;
+	ssize_t r;
+
+	map = mmap(NULL, 3 * 4096, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return -errno;
+	}
+
+	for (i = 0; i < 3 * 4096; i++)
+		if (map[i]) {
+			printf("Anonymous mapping not zeroed\n");
+			return -EINVAL;
+		}
+	memset(map, 0xaa, 3 * 4096);
+
+	/* Punch a hole into the middle, the rest must survive */
+	err = munmap(map + 4096, 4096);
+	if (err) {
+		perror("munmap");
+		return -errno;
+	}
+
+	if ((unsigned char)map[0] != 0xaa ||
+	    (unsigned char)map[2 * 4096] != 0xaa) {
+		printf("Mapping damaged by munmap\n");
+		return -EINVAL;
+	}
+
+	err = mprotect(map, 4096, PROT_READ);
+	if (err) {
+		perror("mprotect");
+		return -errno;
+	}
+
+	munmap(map, 3 * 4096);
+
+	/* File-backed mappings must match read() */
+	fd = open("/initrd/test.txt", O_RDONLY);
+	if (fd == -1) {
+		perror("open");
+		return -errno;
+	}
+
+	r = read(fd, buf, sizeof(buf));
+	if (r <= 0) {
+		perror("read");
+		err = -errno;
+		goto close_out;
+	}
+
+	map = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		err = -errno;
+		goto close_out;
+	}
+
+	err = 0;
+	if (memcmp(map, buf, r) || map[r]) {
+		printf("File mapping differs from file\n");
+		err = -EINVAL;
+	}
+
+	/* Private writes must not reach the file */
+	map[0] = 'x';
+	munmap(map, 4096);
+
+	map = mmap(NULL, 4096, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		err = -errno;
+		goto close_out;
+	}
+
+	if (map[0] != buf[0]) {
+		printf("Private write leaked into the file\n");
+		err = -EINVAL;
+	}
+	munmap(map, 4096);
+
+close_out:
+	close(fd);
+
+	return err;
+}
+
+/*
+ * Large anonymous mappings are backed by huge pages where possible. Exercise
+ * them across fork, and split them by punching holes.
+ */
+static int test_huge(void)
+{
+	const size_t size = 8 * 1024 * 1024;
+	unsigned int i;
+	int status;
+	pid_t child;
+	char *map;
+	int err;
+
+	map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return -errno;
+	}
+
+	for (i = 0; i < size; i += 4096)
+		map[i] = i / 4096;
+
+	child = fork();
+	if (child == -1) {
+		perror("fork");
+		err = -errno;
+		goto unmap_out;
+	} else if (child == 0) {
+		for (i = 0; i < size; i += 4096) {
+			if (map[i] != (char)(i / 4096))
+				exit(1);
+			map[i] = 0;
+		}
+		exit(0);
+	}
+
+	if (waitpid(child, &status, 0) != child) {
+		perror("waitpid");
+		err = -errno;
+		goto unmap_out;
+	}
+
+	if (WEXITSTATUS(status)) {
+		printf("Child failed: %d\n", WEXITSTATUS(status));
+		err = -EINVAL;
+		goto unmap_out;
+	}
+
+	err = munmap(map + size / 2, 4096);
+	if (err) {
+		perror("munmap");
+		err = -errno;
+		goto unmap_out;
+	}
+
+	for (i = 0; i < size; i += 4096) {
+		if (i == size / 2)
+			continue;
+
+		if (map[i] != (char)(i / 4096)) {
+			printf("Huge page damaged at offset 0x%x\n", i);
+			err = -EINVAL;
+			goto unmap_out;
+		}
+	}
+
+unmap_out:
+	munmap(map, size);
+
+	return err;
+}
+
+static int test_sched_policy(void)
+{
+	struct sched_param param;
+	int err;
+
+	param.sched_priority = SCHED_FIFO_PRIO_MIN;
+	err = sched_setscheduler(0, SCHED_FIFO, &param);
+	if (err) {
+		perror("sched_setscheduler");
+		return -errno;
+	}
+
+	err = sched_getscheduler(getpid());
+	if (err != SCHED_FIFO) {
+		printf("Unexpected policy: %d\n", err);
+		return -EINVAL;
+	}
+
+	/* Out of range priorities must be refused */
+	param.sched_priority = SCHED_FIFO_PRIO_MAX + 1;
+	err = sched_setscheduler(0, SCHED_FIFO, &param);
+	if (err != -1 || errno != EINVAL) {
+		printf("Accepted invalid priority\n");
+		return -EINVAL;
+	}
+
+	err = sched_getscheduler(-1);
+	if (err != -1 || errno != EINVAL) {
+		printf("Accepted invalid PID\n");
+		return -EINVAL;
+	}
+
+	param.sched_priority = 0;
+	err = sched_setscheduler(0, SCHED_OTHER, &param);
+	if (err) {
+		perror("sched_setscheduler");
+		return -errno;
+	}
+
+	return sched_getscheduler(0) == SCHED_OTHER ? 0 : -EINVAL;
+}
+
+static int test_pipe(void)
+{
+	unsigned int i, total;
+	struct pollfd pfd;
+	int fds[2], status;
+	char buf[512];
+	pid_t child;
+	ssize_t ss;
+
+	for (i = 0; i < sizeof(pipe_data); i++)
+		pipe_data[i] = i % 251;
+
+	if (pipe(fds)) {
+		perror("pipe");
+		return -errno;
+	}
+
+	/* Nothing to read yet, with and without timeout */
+	pfd.fd = fds[0];
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 0) != 0 || poll(&pfd, 1, 10) != 0) {
+		printf("Empty pipe is readable\n");
+		return -EINVAL;
+	}
+
+	child = fork();
+	if (child == -1) {
+		perror("fork");
+		return -errno;
+	} else if (child == 0) {
+		close(fds[0]);
+		ss = write(fds[1], pipe_data, sizeof(pipe_data));
+		exit(ss == (ssize_t)sizeof(pipe_data) ? 0 : 1);
+	}
+	close(fds[1]);
+
+	/* Read until the child exited and closed the write end */
+	total = 0;
+	for (;;) {
+		if (poll(&pfd, 1, -1) != 1) {
+			perror("poll");
+			return -EINVAL;
+		}
+
+		ss = read(fds[0], buf, sizeof(buf));
+		if (ss < 0) {
+			perror("read");
+			return -errno;
+		}
+		if (ss == 0)
+			break;
+
+		if (total + (size_t)ss > sizeof(pipe_data) ||
+		    memcmp(buf, pipe_data + total, ss)) {
+			printf("Pipe data mismatch\n");
+			return -EINVAL;
+		}
+		total += ss;
+	}
+	close(fds[0]);
+
+	if (waitpid(child, &status, 0) != child) {
+		perror("waitpid");
+		return -errno;
+	}
+
+	if (total != sizeof(pipe_data) || WEXITSTATUS(status)) {
+		printf("Pipe transferred %u bytes\n", total);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
 int test_syscalls(void)
 {
 	int err;
@@ -71,5 +403,30 @@ int test_syscalls(void)
 	if (err)
 		return err;
 
+	printf("Testing copy-on-write\n");
+	err = test_cow();
+	if (err)
+		return err;
+
+	printf("Testing mmap\n");
+	err = test_mmap();
+	if (err)
+		return err;
+
+	printf("Testing huge pages\n");
+	err = test_huge();
+	if (err)
+		return err;
+
+	printf("Testing scheduling policies\n");
+	err = test_sched_policy();
+	if (err)
+		return err;
+
+	printf("Testing pipes\n");
+	err = test_pipe();
+	if (err)
+		return err;
+
 	return err;
 }
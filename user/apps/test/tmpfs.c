@@ -10,11 +10,23 @@
  * the COPYING file in the top-level directory.
  */
 
+#include <dirent.h>
+
+#include <grinch/vsprintf.h>
+
 #include "vfs.h"
 
 #define TMPFS_DIR	"/TEST/"
 #define TMPFS_FILE1	TMPFS_DIR "file1"
 #define TMPFS_FILE2	TMPFS_DIR "file2"
+#define TMPFS_FILE3	TMPFS_DIR "file3"
+#define TMPFS_SUBDIR	TMPFS_DIR "dir"
+
+/* Odd-sized chunks, so that appends straddle page boundaries */
+#define APPEND_CHUNK	37
+#define APPEND_COUNT	1000
+
+#define DENTS_COUNT	200
 
 static const char tmpfs_payload[] = "Hello, world!";
 
@@ -149,6 +161,144 @@ close_out:
         return err;
 }
 
+static int tmpfs_append(const char *pathname)
+{
+	char chunk[APPEND_CHUNK], buf[APPEND_CHUNK];
+	unsigned int i, j;
+	int err, fd;
+	ssize_t ss;
+
+	fd = open(pathname, O_RDWR | O_CREAT);
+	if (fd == -1) {
+		perror("open");
+		return -errno;
+	}
+
+	for (i = 0; i < APPEND_COUNT; i++) {
+		for (j = 0; j < sizeof(chunk); j++)
+			chunk[j] = i + j;
+
+		ss = write(fd, chunk, sizeof(chunk));
+		if (ss != sizeof(chunk)) {
+			perror("write");
+			err = -EINVAL;
+			goto close_out;
+		}
+	}
+	close(fd);
+
+	fd = open(pathname, O_RDONLY);
+	if (fd == -1) {
+		perror("reopen");
+		return -errno;
+	}
+
+	for (i = 0; i < APPEND_COUNT; i++) {
+		ss = read(fd, buf, sizeof(buf));
+		if (ss != sizeof(buf)) {
+			perror("read");
+			err = -EINVAL;
+			goto close_out;
+		}
+
+		for (j = 0; j < sizeof(chunk); j++)
+			chunk[j] = i + j;
+
+		err = -EINVAL;
+		if (memcmp(buf, chunk, sizeof(chunk)))
+			goto close_out;
+	}
+
+	/* End of file */
+	ss = read(fd, buf, sizeof(buf));
+	err = ss ? -EINVAL : 0;
+
+close_out:
+	close(fd);
+
+	return err;
+}
+
+/* Count the entries of pathname, and how many calls that took */
+static int tmpfs_count_dents(const char *pathname, void *buf, size_t size,
+			     unsigned int *calls)
+{
+	int fd, err, entries, i;
+	struct dirent *dent;
+
+	fd = open(pathname, O_RDONLY);
+	if (fd == -1)
+		return -errno;
+
+	err = 0;
+	*calls = 0;
+	for (;;) {
+		entries = getdents(fd, buf, size);
+		if (entries == 0)
+			break;
+		if (entries < 0) {
+			err = -errno;
+			goto close_out;
+		}
+		(*calls)++;
+
+		dent = buf;
+		for (i = 0; i < entries; i++) {
+			if (strncmp(dent->d_name, "f", 1)) {
+				err = -EINVAL;
+				goto close_out;
+			}
+			dent = (void *)dent + dent->d_reclen;
+		}
+		err += entries;
+	}
+
+close_out:
+	close(fd);
+
+	return err;
+}
+
+static int tmpfs_getdents(const char *pathname)
+{
+	char path[64], buf[1024];
+	unsigned int i, calls;
+	int err, fd;
+
+	err = mkdir(pathname, 0);
+	if (err == -1) {
+		perror("mkdir");
+		return -errno;
+	}
+
+	for (i = 0; i < DENTS_COUNT; i++) {
+		snprintf(path, sizeof(path), "%s/f%u", pathname, i);
+		fd = open(path, O_RDWR | O_CREAT);
+		if (fd == -1) {
+			perror("open");
+			return -errno;
+		}
+		close(fd);
+	}
+
+	/* One call must fill the whole buffer */
+	err = tmpfs_count_dents(pathname, buf, sizeof(buf), &calls);
+	if (err < 0)
+		return err;
+	if (err != DENTS_COUNT || calls > DENTS_COUNT / 10)
+		return -EINVAL;
+
+	/* A buffer that only fits one entry resumes at the right place */
+	err = tmpfs_count_dents(pathname, buf, sizeof(struct dirent) + 8,
+				&calls);
+	if (err < 0)
+		return err;
+	if (err != DENTS_COUNT || calls != DENTS_COUNT)
+		return -EINVAL;
+
+	return 0;
+}
+
 int test_tmpfs(void)
 {
 	int err;
@@ -187,5 +337,19 @@ int test_tmpfs(void)
                 return err;
 	}
 
+	printf("tmpfs: append test on %s\n", TMPFS_FILE3);
+	err = tmpfs_append(TMPFS_FILE3);
+	if (err) {
+		perror("append");
+		return err;
+	}
+
+	printf("tmpfs: getdents test on %s\n", TMPFS_SUBDIR);
+	err = tmpfs_getdents(TMPFS_SUBDIR);
+	if (err) {
+		perror("getdents");
+		return err;
+	}
+
 	return 0;
 }
@@ -39,6 +39,8 @@ LIBC_OBJS += fcntl.o
 LIBC_OBJS += getauxval.o
 LIBC_OBJS += ioctl.o
 LIBC_OBJS += libgcc.o
+LIBC_OBJS += mman.o
+LIBC_OBJS += poll.o
 LIBC_OBJS += reboot.o
 LIBC_OBJS += salloc.o
 LIBC_OBJS += stdio.o
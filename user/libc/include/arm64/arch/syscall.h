@@ -59,4 +59,20 @@ static __always_inline long __syscall3(long no, long arg0, long arg1, long arg2)
 	return x0;
 }
 
+static __always_inline long __syscall6(long no, long arg0, long arg1, long arg2,
+				       long arg3, long arg4, long arg5)
+{
+	register long x8 asm("x8") = no;
+	register long x0 asm("x0") = arg0;
+	register long x1 asm("x1") = arg1;
+	register long x2 asm("x2") = arg2;
+	register long x3 asm("x3") = arg3;
+	register long x4 asm("x4") = arg4;
+	register long x5 asm("x5") = arg5;
+
+	__SYSCALL("0"(x0), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5));
+
+	return x0;
+}
+
 #endif /* _ARCH_SYSCALL_H */
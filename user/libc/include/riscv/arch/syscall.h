@@ -72,4 +72,20 @@ static __always_inline long __syscall4(long no, long arg0, long arg1, long arg2,
 	return a0;
 }
 
+static __always_inline long __syscall6(long no, long arg0, long arg1, long arg2,
+				       long arg3, long arg4, long arg5)
+{
+	register long a7 asm("a7") = no;
+	register long a0 asm("a0") = arg0;
+	register long a1 asm("a1") = arg1;
+	register long a2 asm("a2") = arg2;
+	register long a3 asm("a3") = arg3;
+	register long a4 asm("a4") = arg4;
+	register long a5 asm("a5") = arg5;
+
+	__SYSCALL("0"(a0), "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(a5));
+
+	return a0;
+}
+
 #endif /* _ARCH_SYSCALL_H */
@@ -1,7 +1,7 @@
 /*
  * Grinch, a minimalist operating system
  *
- * Copyright (c) OTH Regensburg, 2023-2024
+ * Copyright (c) OTH Regensburg, 2023-2026
  *
  * Authors:
  *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
@@ -13,6 +13,15 @@
 #ifndef _SCHED_H
 #define _SCHED_H
 
+#include <grinch/types.h>
+#include <grinch/sched_abi.h>
+
 int sched_yield(void);
 
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param *param);
+int sched_getscheduler(pid_t pid);
+
+int sched_get_priority_min(int policy);
+int sched_get_priority_max(int policy);
+
 #endif /* _SCHED_H */
@@ -36,6 +36,8 @@ unsigned int sleep(unsigned int seconds);
 int usleep(useconds_t usec);
 
 int close(int fd);
+int pipe(int fds[2]);
+int dup2(int oldfd, int newfd);
 ssize_t write(int fd, const void *buf, size_t count);
 ssize_t read(int fd, void *buf, size_t count);
 
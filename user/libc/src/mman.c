@@ -0,0 +1,36 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <syscall.h>
+#include <sys/mman.h>
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd,
+	   off_t offset)
+{
+	long ret;
+
+	ret = syscall(SYS_mmap, addr, length, prot, flags, fd, offset);
+	if (ret == -1)
+		return MAP_FAILED;
+
+	return (void *)ret;
+}
+
+int munmap(void *addr, size_t length)
+{
+	return syscall(SYS_munmap, addr, length);
+}
+
+int mprotect(void *addr, size_t length, int prot)
+{
+	return syscall(SYS_mprotect, addr, length, prot);
+}
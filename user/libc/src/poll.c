@@ -0,0 +1,19 @@
+/*
+ * Grinch, a minimalist operating system
+ *
+ * Copyright (c) OTH Regensburg, 2026
+ *
+ * Authors:
+ *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
+ *
+ * This work is licensed under the terms of the GNU GPL, version 2.  See
+ * the COPYING file in the top-level directory.
+ */
+
+#include <poll.h>
+#include <syscall.h>
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	return syscall(SYS_poll, fds, nfds, timeout);
+}
@@ -1,7 +1,7 @@
 /*
  * Grinch, a minimalist operating system
  *
- * Copyright (c) OTH Regensburg, 2023-2024
+ * Copyright (c) OTH Regensburg, 2023-2026
  *
  * Authors:
  *  Ralf Ramsauer <ralf.ramsauer@oth-regensburg.de>
@@ -18,3 +18,39 @@ int sched_yield(void)
 {
 	return syscall(SYS_sched_yield);
 }
+
+int sched_setscheduler(pid_t pid, int policy, const struct sched_param *param)
+{
+	return syscall(SYS_sched_setscheduler, pid, policy, param);
+}
+
+int sched_getscheduler(pid_t pid)
+{
+	return syscall(SYS_sched_getscheduler, pid);
+}
+
+int sched_get_priority_min(int policy)
+{
+	switch (policy) {
+	case SCHED_OTHER:
+		return 0;
+	case SCHED_FIFO:
+		return SCHED_FIFO_PRIO_MIN;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+int sched_get_priority_max(int policy)
+{
+	switch (policy) {
+	case SCHED_OTHER:
+		return 0;
+	case SCHED_FIFO:
+		return SCHED_FIFO_PRIO_MAX;
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
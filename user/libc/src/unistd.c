@@ -88,6 +88,16 @@ int close(int fd)
 	return syscall(SYS_close, fd);
 }
 
+int pipe(int fds[2])
+{
+	return syscall(SYS_pipe, fds);
+}
+
+int dup2(int oldfd, int newfd)
+{
+	return syscall(SYS_dup2, oldfd, newfd);
+}
+
 static inline void *__brk(void *addr)
 {
 	return (void *)__syscall(SYS_brk, addr);